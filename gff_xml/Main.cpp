@@ -1,6 +1,47 @@
 #include "gff_xml_core/GffXml.hpp"
+#include "gff_xml_core/Profile.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
 
 int main(int argc, char** argv)
 {
-    return !convert_file(argv[2], argv[1]);
+    ConvertOptions options;
+    std::vector<const char*> args;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--verify-roundtrip") == 0)
+        {
+            options.verify_roundtrip = true;
+        }
+        else if (std::strcmp(argv[i], "--profile") == 0)
+        {
+            if (!profile_enable())
+            {
+                std::printf("Profiling is not compiled in; rebuild with ANPH_PROFILING.\n");
+            }
+        }
+        else
+        {
+            args.push_back(argv[i]);
+        }
+    }
+
+    if (args.size() < 2)
+    {
+        std::printf("Usage: gff_xml [--verify-roundtrip] [--profile] <path_out> <path_in>\n");
+        return 1;
+    }
+
+    if (options.verify_roundtrip && gff_format_for(args[0]) == GffFormat::Binary)
+    {
+        std::printf("--verify-roundtrip only checks gff -> xml; ignoring it.\n");
+        options.verify_roundtrip = false;
+    }
+
+    bool success = convert_file(args[1], args[0], options);
+    profile_print();
+    return !success;
 }
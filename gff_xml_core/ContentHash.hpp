@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+// Fast non-cryptographic 64-bit hash for spotting changed content. Mixes eight bytes at a time; not for security.
+inline std::uint64_t hash_bytes(const void* data, std::size_t len, std::uint64_t seed = 0)
+{
+    constexpr std::uint64_t prime = 0x100000001B3ull;
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    std::uint64_t hash = 0xCBF29CE484222325ull ^ seed ^ (len * prime);
+
+    while (len >= 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, bytes, 8);
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+        bytes += 8;
+        len -= 8;
+    }
+
+    while (len--)
+    {
+        hash = (hash ^ *bytes++) * prime;
+    }
+
+    hash ^= hash >> 32;
+    hash *= 0x9E3779B97F4A7C15ull;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+inline bool hash_file(const std::filesystem::path& path, std::uint64_t* out)
+{
+    FILE* f = std::fopen(path.string().c_str(), "rb");
+    if (!f) return false;
+
+    // Chain fixed-size blocks so large files hash in constant memory.
+    std::vector<unsigned char> block(256 * 1024);
+    std::uint64_t hash = 0;
+    std::size_t read;
+
+    while ((read = std::fread(block.data(), 1, block.size(), f)) > 0)
+    {
+        hash = hash_bytes(block.data(), read, hash);
+    }
+
+    bool success = !std::ferror(f);
+    std::fclose(f);
+    *out = hash;
+    return success;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "GffXml.hpp"
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+// Prints the message, or appends it to report->log when the caller asked for output to be captured.
+template <typename ... Args>
+void log_msg(ConvertReport* report, const char* fmt, Args&& ... args)
+{
+    if (!report)
+    {
+        std::printf(fmt, args ...);
+        return;
+    }
+
+    int len = std::snprintf(nullptr, 0, fmt, args ...);
+
+    if (len > 0)
+    {
+        std::size_t offset = report->log.size();
+        report->log.resize(offset + len + 1);
+        std::snprintf(report->log.data() + offset, len + 1, fmt, args ...);
+        report->log.resize(offset + len);
+    }
+}
@@ -0,0 +1,77 @@
+#include "ErfView.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace ErfFormat;
+
+namespace {
+
+std::uint32_t read_u32(const std::byte* pos)
+{
+    std::uint32_t value;
+    std::memcpy(&value, pos, sizeof(value));
+    return value;
+}
+
+std::uint16_t read_u16(const std::byte* pos)
+{
+    std::uint16_t value;
+    std::memcpy(&value, pos, sizeof(value));
+    return value;
+}
+
+}
+
+bool ErfView::open(const std::byte* data, std::size_t len)
+{
+    m_resources.clear();
+
+    if (len < header_size) return fail("File is not an ERF.");
+    if (std::memcmp(data + 4, "V1.0", 4) != 0) return fail("Unsupported ERF version.");
+
+    std::uint64_t strings_size = read_u32(data + 12);
+    std::uint64_t count = read_u32(data + 16);
+    std::uint64_t keys_offset = read_u32(data + 24);
+    std::uint64_t resources_offset = read_u32(data + 28);
+
+    if (keys_offset + count * key_size > len) return fail("ERF key list extends past the end of the file.");
+    if (resources_offset + count * resource_size > len)
+    {
+        return fail("ERF resource list extends past the end of the file.");
+    }
+
+    m_data = data;
+    m_resources.reserve((std::size_t)count);
+
+    std::uint64_t used = header_size + strings_size + count * (key_size + resource_size);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const std::byte* key = data + keys_offset + i * key_size;
+        const std::byte* entry = data + resources_offset + i * resource_size;
+
+        ErfResourceView res;
+        res.resref = std::string_view(reinterpret_cast<const char*>(key), resref_size);
+        res.resref = res.resref.substr(0, res.resref.find('\0'));
+        res.type = (FileFormats::Resource::ResourceType)read_u16(key + resref_size + 4);
+        res.offset = read_u32(entry);
+        res.size = read_u32(entry + 4);
+
+        if ((std::uint64_t)res.offset + res.size > len) return fail("ERF resource extends past the end of the file.");
+
+        m_resources.push_back(res);
+        used += res.size;
+    }
+
+    // Resources sharing their data could add up to more than the file.
+    m_dead_space = len - std::min<std::uint64_t>(used, len);
+    return true;
+}
+
+bool ErfView::fail(const char* message)
+{
+    m_resources.clear();
+    m_error = message;
+    return false;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "FileFormats/Resource.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Layout of an ERF (V1.0) - .mod, .hak, .erf: a header, then the description strings, one key per resource, and one
+// offset and size per resource, each found through an offset in the header, and the resource data.
+namespace ErfFormat {
+
+// FileType[4], Version[4], LanguageCount, LocalizedStringSize, EntryCount, OffsetToLocalizedString, OffsetToKeyList,
+// OffsetToResourceList, BuildYear, BuildDay, DescriptionStrRef, Reserved[116].
+constexpr std::size_t header_size = 160;
+
+// ResRef[16], ResID, ResType (16 bits), Unused (16 bits).
+constexpr std::size_t key_size = 24;
+constexpr std::size_t resref_size = 16;
+
+// OffsetToResource, ResourceSize.
+constexpr std::size_t resource_size = 8;
+
+}
+
+// One resource as it is stored. The ResRef points into the ERF's bytes.
+struct ErfResourceView
+{
+    std::string_view resref; // Up to the first NUL.
+    FileFormats::Resource::ResourceType type;
+    std::uint32_t offset;
+    std::uint32_t size;
+};
+
+// Read-only view of an ERF's tables. open() checks the header and that every resource lies within the file; the
+// resource data itself is left where it is. The bytes (usually a MappedFile) must outlive the view and everything
+// obtained from it.
+class ErfView
+{
+public:
+    bool open(const std::byte* data, std::size_t len);
+
+    const std::vector<ErfResourceView>& resources() const { return m_resources; }
+    const std::byte* data(const ErfResourceView& res) const { return m_data + res.offset; }
+
+    // Bytes of the file neither the header, the tables nor any listed resource take up - what ErfWriter::update()
+    // leaves behind.
+    std::uint64_t dead_space() const { return m_dead_space; }
+
+    const char* error() const { return m_error; }
+
+private:
+    bool fail(const char* message);
+
+    const std::byte* m_data = nullptr;
+    std::vector<ErfResourceView> m_resources;
+    std::uint64_t m_dead_space = 0;
+    const char* m_error = "";
+};
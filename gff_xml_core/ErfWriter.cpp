@@ -0,0 +1,364 @@
+#include "ErfWriter.hpp"
+#include "ErfView.hpp"
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <limits>
+
+#if defined(__linux__)
+    #include <cerrno>
+    #include <sys/sendfile.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+using namespace ErfFormat;
+
+namespace {
+
+// No description StrRef; the description strings stand on their own.
+constexpr std::uint32_t no_strref = 0xFFFFFFFF;
+
+void write_u32(std::byte* pos, std::uint32_t value)
+{
+    std::memcpy(pos, &value, sizeof(value));
+}
+
+void write_u16(std::byte* pos, std::uint16_t value)
+{
+    std::memcpy(pos, &value, sizeof(value));
+}
+
+bool fail(std::string* error, std::string message)
+{
+    *error = std::move(message);
+    return false;
+}
+
+#if defined(__linux__)
+
+enum class CopyResult { Done, Unsupported, Failed };
+
+bool unsupported(int err)
+{
+    return err == EXDEV || err == EINVAL || err == ENOSYS || err == EOPNOTSUPP;
+}
+
+// Has the kernel move size bytes from in to out, page cache to page cache, without them passing through us - and on
+// filesystems that can, sharing the blocks rather than copying them at all. copy_file_range is tried first, then
+// sendfile. Unsupported means nothing was copied and the caller should copy the bytes itself.
+CopyResult kernel_copy(int in, int out, std::uint64_t size)
+{
+    // Both calls take at most a little under 2 GB at a time.
+    constexpr std::uint64_t max_chunk = 1ull << 30;
+
+    bool use_sendfile = false;
+    std::uint64_t copied = 0;
+
+    while (copied < size)
+    {
+        std::size_t chunk = (std::size_t)std::min(size - copied, max_chunk);
+        ssize_t done = use_sendfile
+            ? ::sendfile(out, in, nullptr, chunk)
+            : ::copy_file_range(in, nullptr, out, nullptr, chunk, 0);
+
+        if (done > 0)
+        {
+            copied += (std::uint64_t)done;
+            continue;
+        }
+
+        if (done == 0) return CopyResult::Failed; // The file is shorter than it was.
+        if (errno == EINTR) continue;
+        if (copied > 0 || !unsupported(errno)) return CopyResult::Failed;
+        if (use_sendfile) return CopyResult::Unsupported;
+
+        use_sendfile = true;
+    }
+
+    return CopyResult::Done;
+}
+
+#endif
+
+// Copies the source file into out at its current position, failing if it's no longer size bytes long.
+bool stream_file(const std::filesystem::path& path, std::uint64_t size, FILE* out, std::string* error)
+{
+#if defined(__linux__)
+    int in = ::open(path.c_str(), O_RDONLY);
+    if (in == -1) return fail(error, "Failed to open " + path.string() + ".");
+
+    struct stat info;
+    bool same_size = ::fstat(in, &info) == 0 && (std::uint64_t)info.st_size == size;
+    CopyResult result = CopyResult::Failed;
+
+    // The kernel writes at the descriptor's position, so anything still buffered in out has to go first.
+    if (same_size && std::fflush(out) == 0)
+    {
+        result = kernel_copy(in, ::fileno(out), size);
+    }
+
+    ::close(in);
+
+    if (!same_size) return fail(error, path.string() + " changed size while the module was being built.");
+    if (result == CopyResult::Done) return true;
+    if (result == CopyResult::Failed) return fail(error, "Failed to copy " + path.string() + ".");
+#endif
+
+    // Mapped, the only copy made is the one into out.
+    MappedFile data;
+
+    if (!data.open(path))
+    {
+        return fail(error, "Failed to open " + path.string() + ".");
+    }
+
+    if (data.size() != size)
+    {
+        return fail(error, path.string() + " changed size while the module was being built.");
+    }
+
+    if (size > 0 && std::fwrite(data.data(), (std::size_t)size, 1, out) != 1)
+    {
+        return fail(error, "Failed to copy " + path.string() + ".");
+    }
+
+    return true;
+}
+
+}
+
+ErfWriter::ErfWriter(const char* file_type)
+{
+    std::memcpy(m_file_type, file_type, sizeof(m_file_type));
+}
+
+void ErfWriter::add_description(std::uint32_t language_id, std::string text)
+{
+    m_descriptions.push_back({ language_id, std::move(text) });
+}
+
+void ErfWriter::add_file(std::string resref, FileFormats::Resource::ResourceType type, std::filesystem::path path,
+    std::uint64_t size)
+{
+    m_resources.push_back({ std::move(resref), type, std::move(path), {}, size, {} });
+}
+
+void ErfWriter::add_data(std::string resref, FileFormats::Resource::ResourceType type, std::vector<std::byte> data)
+{
+    std::uint64_t size = data.size();
+    m_resources.push_back({ std::move(resref), type, {}, std::move(data), size, {} });
+}
+
+void ErfWriter::add_existing(std::string resref, FileFormats::Resource::ResourceType type, std::uint32_t offset,
+    std::uint32_t size)
+{
+    m_resources.push_back({ std::move(resref), type, {}, {}, size, offset });
+}
+
+bool ErfWriter::write(const std::filesystem::path& path, std::string* error) const
+{
+    for (const Resource& res : m_resources)
+    {
+        if (res.existing_offset) return fail(error, "Resource " + res.resref + " is only in an ERF being updated.");
+    }
+
+    // Everything ahead of the resource data is small, so it's laid out in memory and written in one go.
+    std::uint64_t data_offset = header_size + tables_size();
+    std::vector<std::byte> tables((std::size_t)data_offset, std::byte { 0 });
+
+    encode_header(header_size, tables.data());
+    if (!encode_tables(header_size, data_offset, tables.data() + header_size, error)) return false;
+
+    // Written beside the target and renamed over it once complete, so a failure part way - a source that changed
+    // size, say - leaves the previous ERF as it was rather than a truncated one.
+    std::filesystem::path temp_path = path;
+    temp_path += ".tmp";
+
+    FILE* out = std::fopen(temp_path.string().c_str(), "wb");
+
+    if (!out)
+    {
+        return fail(error, "Failed to open " + temp_path.string() + " for writing.");
+    }
+
+    bool success = std::fwrite(tables.data(), tables.size(), 1, out) == 1
+        ? write_data(out, temp_path, error)
+        : fail(error, "Failed to write " + temp_path.string() + ".");
+
+    if (std::fclose(out) != 0 && success)
+    {
+        success = fail(error, "Failed to write " + temp_path.string() + ".");
+    }
+
+    std::error_code ec;
+
+    if (success)
+    {
+        std::filesystem::rename(temp_path, path, ec);
+        if (ec) success = fail(error, "Failed to replace " + path.string() + ".");
+    }
+
+    if (!success)
+    {
+        std::filesystem::remove(temp_path, ec);
+    }
+
+    return success;
+}
+
+bool ErfWriter::update(const std::filesystem::path& path, std::string* error) const
+{
+    std::error_code ec;
+    std::uint64_t data_offset = std::filesystem::file_size(path, ec);
+    if (ec) return fail(error, "Failed to open " + path.string() + ".");
+
+    std::uint64_t tables_offset = data_offset;
+
+    for (const Resource& res : m_resources)
+    {
+        if (!res.existing_offset) tables_offset += res.size;
+    }
+
+    std::vector<std::byte> header(header_size, std::byte { 0 });
+    std::vector<std::byte> tables((std::size_t)tables_size(), std::byte { 0 });
+
+    encode_header(tables_offset, header.data());
+    if (!encode_tables(tables_offset, data_offset, tables.data(), error)) return false;
+
+    FILE* out = std::fopen(path.string().c_str(), "r+b");
+
+    if (!out)
+    {
+        return fail(error, "Failed to open " + path.string() + " for writing.");
+    }
+
+    bool success = std::fseek(out, 0, SEEK_END) == 0
+        ? write_data(out, path, error)
+        : fail(error, "Failed to write " + path.string() + ".");
+
+    if (success && (std::fwrite(tables.data(), tables.size(), 1, out) != 1
+        || std::fseek(out, 0, SEEK_SET) != 0
+        || std::fwrite(header.data(), header.size(), 1, out) != 1))
+    {
+        success = fail(error, "Failed to write " + path.string() + ".");
+    }
+
+    if (std::fclose(out) != 0 && success)
+    {
+        success = fail(error, "Failed to write " + path.string() + ".");
+    }
+
+    return success;
+}
+
+std::uint64_t ErfWriter::strings_size() const
+{
+    std::uint64_t size = 0;
+
+    for (const Description& desc : m_descriptions)
+    {
+        size += 8 + desc.text.size();
+    }
+
+    return size;
+}
+
+std::uint64_t ErfWriter::tables_size() const
+{
+    return strings_size() + m_resources.size() * (key_size + resource_size);
+}
+
+void ErfWriter::encode_header(std::uint64_t tables_offset, std::byte* out) const
+{
+    std::uint64_t keys_offset = tables_offset + strings_size();
+    std::uint64_t resources_offset = keys_offset + m_resources.size() * key_size;
+
+    std::time_t now = std::time(nullptr);
+    const std::tm* date = std::gmtime(&now);
+
+    std::memcpy(out, m_file_type, 4);
+    std::memcpy(out + 4, "V1.0", 4);
+    write_u32(out + 8, (std::uint32_t)m_descriptions.size());
+    write_u32(out + 12, (std::uint32_t)strings_size());
+    write_u32(out + 16, (std::uint32_t)m_resources.size());
+    write_u32(out + 20, (std::uint32_t)tables_offset);
+    write_u32(out + 24, (std::uint32_t)keys_offset);
+    write_u32(out + 28, (std::uint32_t)resources_offset);
+    write_u32(out + 32, (std::uint32_t)date->tm_year);
+    write_u32(out + 36, (std::uint32_t)date->tm_yday);
+    write_u32(out + 40, no_strref);
+}
+
+bool ErfWriter::encode_tables(std::uint64_t tables_offset, std::uint64_t data_offset, std::byte* out,
+    std::string* error) const
+{
+    std::byte* string = out;
+
+    for (const Description& desc : m_descriptions)
+    {
+        write_u32(string, desc.language_id);
+        write_u32(string + 4, (std::uint32_t)desc.text.size());
+        std::memcpy(string + 8, desc.text.data(), desc.text.size());
+        string += 8 + desc.text.size();
+    }
+
+    std::byte* keys = string;
+    std::byte* resources = keys + m_resources.size() * key_size;
+    std::uint64_t offset = data_offset;
+
+    for (std::size_t i = 0; i < m_resources.size(); ++i)
+    {
+        const Resource& res = m_resources[i];
+        std::byte* key = keys + i * key_size;
+        std::byte* entry = resources + i * resource_size;
+
+        if (res.resref.size() > resref_size)
+        {
+            return fail(error, "ResRef " + res.resref + " is longer than 16 characters.");
+        }
+
+        std::memcpy(key, res.resref.data(), res.resref.size());
+        write_u32(key + resref_size, (std::uint32_t)i);
+        write_u16(key + resref_size + 4, (std::uint16_t)res.type);
+
+        write_u32(entry, res.existing_offset ? *res.existing_offset : (std::uint32_t)offset);
+        write_u32(entry + 4, (std::uint32_t)res.size);
+
+        if (!res.existing_offset)
+        {
+            offset += res.size;
+        }
+    }
+
+    // Offsets are 32 bits, so neither the tables nor the data can end past 4 GB.
+    if (std::max(offset, tables_offset + tables_size()) > std::numeric_limits<std::uint32_t>::max())
+    {
+        return fail(error, "ERF would exceed 4 GB.");
+    }
+
+    return true;
+}
+
+bool ErfWriter::write_data(FILE* out, const std::filesystem::path& path, std::string* error) const
+{
+    for (const Resource& res : m_resources)
+    {
+        if (res.existing_offset) continue;
+
+        if (!res.path.empty())
+        {
+            if (!stream_file(res.path, res.size, out, error)) return false;
+        }
+        else if (!res.data.empty() && std::fwrite(res.data.data(), res.data.size(), 1, out) != 1)
+        {
+            return fail(error, "Failed to write " + path.string() + ".");
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "FileFormats/Resource.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Writes an ERF without holding its content in memory. Resources added with add_file are only listed up front, with
+// the size they had then, so the key and resource tables can be laid out before any data is read; write() then
+// streams each file into place from disk. Only resources added with add_data - generated ones - live in memory.
+// update() writes just what changed into an existing ERF instead.
+class ErfWriter
+{
+public:
+    explicit ErfWriter(const char* file_type); // Four characters, e.g. "MOD ".
+
+    void add_description(std::uint32_t language_id, std::string text);
+
+    // Fails at write() if the file is no longer size bytes long by then.
+    void add_file(std::string resref, FileFormats::Resource::ResourceType type, std::filesystem::path path,
+        std::uint64_t size);
+
+    void add_data(std::string resref, FileFormats::Resource::ResourceType type, std::vector<std::byte> data);
+
+    // Adds a resource that the ERF being updated already holds at offset, for update() to leave where it is.
+    void add_existing(std::string resref, FileFormats::Resource::ResourceType type, std::uint32_t offset,
+        std::uint32_t size);
+
+    // Resources go in the order they were added. The ERF at path is only replaced once the new one is complete; on
+    // failure it is left as it was, and error describes what was wrong.
+    bool write(const std::filesystem::path& path, std::string* error) const;
+
+    // Updates the ERF at path in place rather than writing it afresh. Existing resources stay where they are; the rest
+    // are appended, followed by new tables, and the header is rewritten last to point at those. Until then the ERF
+    // reads as it did before, as nothing it refers to has been touched. The old tables, and the data of resources no
+    // longer listed, are left behind as dead space.
+    bool update(const std::filesystem::path& path, std::string* error) const;
+
+private:
+    struct Description
+    {
+        std::uint32_t language_id;
+        std::string text;
+    };
+
+    struct Resource
+    {
+        std::string resref;
+        FileFormats::Resource::ResourceType type;
+        std::filesystem::path path; // Streamed from here; empty if the data is in memory or already in place.
+        std::vector<std::byte> data;
+        std::uint64_t size;
+        std::optional<std::uint32_t> existing_offset;
+    };
+
+    std::uint64_t strings_size() const;
+    std::uint64_t tables_size() const;
+
+    // The header, for tables written at tables_offset.
+    void encode_header(std::uint64_t tables_offset, std::byte* out) const;
+
+    // The description strings, key list and resource list, to be written at tables_offset, with the resources not
+    // already in place laid out in order from data_offset.
+    bool encode_tables(std::uint64_t tables_offset, std::uint64_t data_offset, std::byte* out,
+        std::string* error) const;
+
+    // Writes the data of every resource not already in place, in order, at out's position.
+    bool write_data(FILE* out, const std::filesystem::path& path, std::string* error) const;
+
+    char m_file_type[4];
+    std::vector<Description> m_descriptions;
+    std::vector<Resource> m_resources;
+};
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "GffLabel.hpp"
+#include "FileFormats/Gff.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Text encoding of GFF field values, shared by everything that reads or writes GFF as text.
+// field_codecs holds one entry per Raw::GffField::Type, in enum order, so both directions look up the same tag name
+// and the same value format and can't drift apart.
+
+namespace FieldCodecs {
+
+using namespace FileFormats::Gff;
+
+using FieldRef = Friendly::GffStruct::FieldMap::value_type;
+
+// Storage that formatted text can live in until the caller is done with it.
+struct FormatScratch
+{
+    char chars[64];
+    Friendly::Type_CExoString string;
+};
+
+inline std::string_view trim(std::string_view text)
+{
+    constexpr const char* whitespace = " \t\r\n";
+    std::size_t first = text.find_first_not_of(whitespace);
+    if (first == std::string_view::npos) return {};
+    return text.substr(first, text.find_last_not_of(whitespace) - first + 1);
+}
+
+template <typename T>
+bool parse_value(std::string_view text, T* out)
+{
+    text = trim(text);
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), *out);
+    return ec == std::errc() && end == text.data() + text.size();
+}
+
+template <typename T>
+const char* format_value(T value, FormatScratch* scratch)
+{
+    // For floating point this is the shortest text that parses back to exactly the same value.
+    char* end = std::to_chars(scratch->chars, scratch->chars + sizeof(scratch->chars) - 1, value).ptr;
+    *end = '\0';
+    return scratch->chars;
+}
+
+template <typename T>
+bool parse_field(std::string_view text, const char* label, Friendly::GffStruct* struc)
+{
+    T value;
+    if (!parse_value(text, &value)) return false;
+    struc->WriteField(label, std::move(value));
+    return true;
+}
+
+template <typename T>
+const char* format_field(const Friendly::GffStruct& struc, const FieldRef& field, FormatScratch* scratch)
+{
+    T value;
+    struc.ReadField(field, &value);
+    return format_value(value, scratch);
+}
+
+// Checks that text, as produced by the field's formatter, reads back as a bit-identical value.
+template <typename T>
+bool verify_field(const Friendly::GffStruct& struc, const FieldRef& field, const char* text)
+{
+    T original;
+    T parsed;
+    struc.ReadField(field, &original);
+    return parse_value(text, &parsed) && std::memcmp(&original, &parsed, sizeof(T)) == 0;
+}
+
+inline bool parse_cexostring(std::string_view text, const char* label, Friendly::GffStruct* struc)
+{
+    Friendly::Type_CExoString value;
+    value.m_String.assign(text);
+    struc->WriteField(label, std::move(value));
+    return true;
+}
+
+inline const char* format_cexostring(const Friendly::GffStruct& struc, const FieldRef& field, FormatScratch* scratch)
+{
+    struc.ReadField(field, &scratch->string);
+    return scratch->string.m_String.c_str();
+}
+
+inline bool verify_cexostring(const Friendly::GffStruct& struc, const FieldRef& field, const char* text)
+{
+    Friendly::Type_CExoString original;
+    struc.ReadField(field, &original);
+    return original.m_String == text;
+}
+
+inline bool parse_resref(std::string_view text, const char* label, Friendly::GffStruct* struc)
+{
+    Friendly::Type_CResRef value;
+    if (text.size() > sizeof(value.m_String)) return false;
+    value.m_Size = (std::uint8_t)text.size();
+    std::memcpy(value.m_String, text.data(), value.m_Size);
+    struc->WriteField(label, std::move(value));
+    return true;
+}
+
+inline const char* format_resref(const Friendly::GffStruct& struc, const FieldRef& field, FormatScratch* scratch)
+{
+    Friendly::Type_CResRef value;
+    struc.ReadField(field, &value);
+    std::size_t len = std::min<std::size_t>(value.m_Size, sizeof(value.m_String));
+    len = std::find(value.m_String, value.m_String + len, '\0') - value.m_String;
+    std::memcpy(scratch->chars, value.m_String, len);
+    scratch->chars[len] = '\0';
+    return scratch->chars;
+}
+
+inline bool verify_resref(const Friendly::GffStruct& struc, const FieldRef& field, const char* text)
+{
+    Friendly::Type_CResRef original;
+    struc.ReadField(field, &original);
+    return original.m_Size == std::strlen(text) && std::memcmp(original.m_String, text, original.m_Size) == 0;
+}
+
+struct SortedField
+{
+    GffLabel label;
+    const FieldRef* field;
+
+    operator const FieldRef*() const { return field; }
+};
+
+// Fields sorted by label, so the same content always produces the same document whatever order the field map
+// happens to iterate in. Sorted on inline labels; the full text only breaks ties between labels too long for GFF.
+inline std::vector<SortedField> sorted_fields(const Friendly::GffStruct& struc)
+{
+    std::vector<SortedField> fields;
+    fields.reserve(struc.GetFields().size());
+
+    for (const FieldRef& kvp : struc.GetFields())
+    {
+        fields.push_back({ GffLabel(kvp.first), &kvp });
+    }
+
+    std::sort(std::begin(fields), std::end(fields), [](const SortedField& lhs, const SortedField& rhs)
+    {
+        if (lhs.label != rhs.label) return lhs.label < rhs.label;
+        return lhs.field->first < rhs.field->first;
+    });
+
+    return fields;
+}
+
+struct FieldCodec
+{
+    Raw::GffField::Type type;
+
+    // Element name in XML and leading word in GFF text. Null for types that have no text form (VOID).
+    const char* tag;
+
+    // All null for the types with structure of their own (CExoLocString, VOID, Struct, List); callers handle those.
+    bool (*parse)(std::string_view text, const char* label, Friendly::GffStruct* struc);
+    const char* (*format)(const Friendly::GffStruct& struc, const FieldRef& field, FormatScratch* scratch);
+    bool (*verify)(const Friendly::GffStruct& struc, const FieldRef& field, const char* text);
+};
+
+inline constexpr std::array<FieldCodec, 16> field_codecs =
+{{
+    { Raw::GffField::Type::BYTE,          "Byte",          &parse_field<Friendly::Type_BYTE>,     &format_field<Friendly::Type_BYTE>,     &verify_field<Friendly::Type_BYTE> },
+    { Raw::GffField::Type::CHAR,          "Char",          &parse_field<Friendly::Type_CHAR>,     &format_field<Friendly::Type_CHAR>,     &verify_field<Friendly::Type_CHAR> },
+    { Raw::GffField::Type::WORD,          "Word",          &parse_field<Friendly::Type_WORD>,     &format_field<Friendly::Type_WORD>,     &verify_field<Friendly::Type_WORD> },
+    { Raw::GffField::Type::SHORT,         "Short",         &parse_field<Friendly::Type_SHORT>,    &format_field<Friendly::Type_SHORT>,    &verify_field<Friendly::Type_SHORT> },
+    { Raw::GffField::Type::DWORD,         "DWord",         &parse_field<Friendly::Type_DWORD>,    &format_field<Friendly::Type_DWORD>,    &verify_field<Friendly::Type_DWORD> },
+    { Raw::GffField::Type::INT,           "Int",           &parse_field<Friendly::Type_INT>,      &format_field<Friendly::Type_INT>,      &verify_field<Friendly::Type_INT> },
+    { Raw::GffField::Type::DWORD64,       "DWord64",       &parse_field<Friendly::Type_DWORD64>,  &format_field<Friendly::Type_DWORD64>,  &verify_field<Friendly::Type_DWORD64> },
+    { Raw::GffField::Type::INT64,         "Int64",         &parse_field<Friendly::Type_INT64>,    &format_field<Friendly::Type_INT64>,    &verify_field<Friendly::Type_INT64> },
+    { Raw::GffField::Type::FLOAT,         "Float",         &parse_field<Friendly::Type_FLOAT>,    &format_field<Friendly::Type_FLOAT>,    &verify_field<Friendly::Type_FLOAT> },
+    { Raw::GffField::Type::DOUBLE,        "Double",        &parse_field<Friendly::Type_DOUBLE>,   &format_field<Friendly::Type_DOUBLE>,   &verify_field<Friendly::Type_DOUBLE> },
+    { Raw::GffField::Type::CExoString,    "CExoString",    &parse_cexostring,                     &format_cexostring,                     &verify_cexostring },
+    { Raw::GffField::Type::ResRef,        "ResRef",        &parse_resref,                         &format_resref,                         &verify_resref },
+    { Raw::GffField::Type::CExoLocString, "CExoLocString", nullptr,                               nullptr,                                nullptr },
+    { Raw::GffField::Type::VOID,          nullptr,         nullptr,                               nullptr,                                nullptr },
+    { Raw::GffField::Type::Struct,        "Struct",        nullptr,                               nullptr,                                nullptr },
+    { Raw::GffField::Type::List,          "List",          nullptr,                               nullptr,                                nullptr },
+}};
+
+constexpr bool codecs_in_type_order()
+{
+    for (std::size_t i = 0; i < field_codecs.size(); ++i)
+    {
+        if ((std::size_t)field_codecs[i].type != i) return false;
+    }
+
+    return true;
+}
+
+static_assert(codecs_in_type_order(), "field_codecs must be indexable by Raw::GffField::Type.");
+
+// Tag lookup goes through a perfect hash over the tag names; the table below is built at compile time and the
+// build fails if two tags ever collide.
+
+constexpr std::size_t tag_table_size = 32;
+
+constexpr std::size_t tag_hash(std::string_view tag)
+{
+    if (tag.empty()) return 0;
+    return (tag.size() + 2 * (unsigned char)tag.front() + 2 * (unsigned char)tag.back()) % tag_table_size;
+}
+
+inline constexpr std::array<std::int8_t, tag_table_size> tag_table = []
+{
+    std::array<std::int8_t, tag_table_size> table {};
+
+    for (std::int8_t& slot : table)
+    {
+        slot = -1;
+    }
+
+    for (std::size_t i = 0; i < field_codecs.size(); ++i)
+    {
+        if (!field_codecs[i].tag) continue;
+        std::size_t hash = tag_hash(field_codecs[i].tag);
+        if (table[hash] != -1) throw "Field tags collide in tag_hash - pick new constants.";
+        table[hash] = (std::int8_t)i;
+    }
+
+    return table;
+}();
+
+inline const FieldCodec* find_codec(std::string_view tag)
+{
+    std::int8_t index = tag_table[tag_hash(tag)];
+    if (index < 0 || field_codecs[index].tag != tag) return nullptr;
+    return &field_codecs[index];
+}
+
+inline const FieldCodec& codec_for(Raw::GffField::Type type)
+{
+    return field_codecs[(std::size_t)type];
+}
+
+}
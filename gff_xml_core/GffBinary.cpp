@@ -0,0 +1,143 @@
+#include "GffBinary.hpp"
+#include "GffView.hpp"
+
+#include <cstring>
+#include <vector>
+
+using namespace FileFormats::Gff;
+
+namespace {
+
+// Materialises a whole GffView into Friendly types.
+class GffDecoder
+{
+public:
+    GffDecoder(const GffView& view)
+        : m_view(view), m_active(view.struct_count(), false)
+    { }
+
+    bool read_struct(const GffStructView& struc, Friendly::GffStruct* out)
+    {
+        // Structs nest by index, so a corrupt file could loop back on itself.
+        if (m_active[struc.index()]) return fail("Struct contains itself.");
+        m_active[struc.index()] = true;
+
+        out->SetUserDefinedId(struc.id());
+
+        for (std::uint32_t i = 0; i < struc.field_count(); ++i)
+        {
+            GffFieldView field;
+            if (!struc.field(i, &field) || !read_field(field, out)) return fail(m_view.error());
+        }
+
+        m_active[struc.index()] = false;
+        return true;
+    }
+
+    const char* error() const
+    {
+        return m_error;
+    }
+
+private:
+    bool fail(const char* message)
+    {
+        if (!*m_error)
+        {
+            m_error = message;
+        }
+
+        return false;
+    }
+
+    template <typename T>
+    bool read_value(const GffFieldView& field, const char* label, Friendly::GffStruct* out)
+    {
+        T value;
+        if (!field.read(&value)) return false;
+        out->WriteField(label, std::move(value));
+        return true;
+    }
+
+    bool read_field(const GffFieldView& field, Friendly::GffStruct* out)
+    {
+        char label[17] = {};
+        std::memcpy(label, field.label().data(), field.label().size());
+
+        switch (field.type())
+        {
+            case Raw::GffField::Type::BYTE: return read_value<Friendly::Type_BYTE>(field, label, out);
+            case Raw::GffField::Type::CHAR: return read_value<Friendly::Type_CHAR>(field, label, out);
+            case Raw::GffField::Type::WORD: return read_value<Friendly::Type_WORD>(field, label, out);
+            case Raw::GffField::Type::SHORT: return read_value<Friendly::Type_SHORT>(field, label, out);
+            case Raw::GffField::Type::DWORD: return read_value<Friendly::Type_DWORD>(field, label, out);
+            case Raw::GffField::Type::INT: return read_value<Friendly::Type_INT>(field, label, out);
+            case Raw::GffField::Type::DWORD64: return read_value<Friendly::Type_DWORD64>(field, label, out);
+            case Raw::GffField::Type::INT64: return read_value<Friendly::Type_INT64>(field, label, out);
+            case Raw::GffField::Type::FLOAT: return read_value<Friendly::Type_FLOAT>(field, label, out);
+            case Raw::GffField::Type::DOUBLE: return read_value<Friendly::Type_DOUBLE>(field, label, out);
+            case Raw::GffField::Type::CExoString: return read_value<Friendly::Type_CExoString>(field, label, out);
+            case Raw::GffField::Type::ResRef: return read_value<Friendly::Type_CResRef>(field, label, out);
+            case Raw::GffField::Type::CExoLocString: return read_value<Friendly::Type_CExoLocString>(field, label, out);
+            case Raw::GffField::Type::VOID: return read_value<Friendly::Type_VOID>(field, label, out);
+
+            case Raw::GffField::Type::Struct:
+            {
+                GffStructView child;
+                Friendly::Type_Struct value;
+                if (!field.read(&child) || !read_struct(child, &value)) return false;
+                out->WriteField(label, std::move(value));
+                return true;
+            }
+
+            case Raw::GffField::Type::List:
+            {
+                GffListView list;
+                if (!field.read(&list)) return false;
+
+                Friendly::Type_List value;
+                value.GetStructs().resize(list.size());
+
+                for (std::uint32_t i = 0; i < list.size(); ++i)
+                {
+                    GffStructView child;
+                    if (!list.at(i, &child) || !read_struct(child, &value.GetStructs()[i])) return false;
+                }
+
+                out->WriteField(label, std::move(value));
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    const GffView& m_view;
+    std::vector<bool> m_active;
+    const char* m_error = "";
+};
+
+}
+
+bool read_gff_binary(const std::byte* data, std::size_t len, Friendly::Gff* out, std::string* error)
+{
+    GffView view;
+    GffStructView top;
+
+    if (!view.open(data, len) || !view.top_level(&top))
+    {
+        *error = view.error();
+        return false;
+    }
+
+    GffDecoder decoder(view);
+
+    if (!decoder.read_struct(top, &out->GetTopLevelStruct()))
+    {
+        *error = decoder.error();
+        return false;
+    }
+
+    std::memcpy(out->GetFileType(), view.file_type(), 4);
+    return true;
+}
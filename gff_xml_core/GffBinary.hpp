@@ -0,0 +1,12 @@
+#pragma once
+
+#include "FileFormats/Gff.hpp"
+
+#include <cstddef>
+#include <string>
+
+// Decodes binary GFF (V3.2) straight from the given bytes - typically a MappedFile - into out, walking the tables
+// in place through a GffView. The only allocations are the Friendly::Gff tree itself, where going through Raw::Gff
+// would first copy every table into owned buffers and then copy everything again. On failure, error describes what
+// was wrong.
+bool read_gff_binary(const std::byte* data, std::size_t len, FileFormats::Gff::Friendly::Gff* out, std::string* error);
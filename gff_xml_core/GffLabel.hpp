@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// A GFF field label held inline as the two 64-bit halves of the 16 null-padded bytes binary GFF stores it in. Labels
+// are compared, sorted and looked up for every field written; as a GffLabel that is a pair of integer compares or a
+// cheap hash, with no allocation. The halves are the label bytes read big-endian, so integer order is the lexical
+// order of the text.
+class GffLabel
+{
+public:
+    static constexpr std::size_t max_size = 16;
+
+    GffLabel() = default;
+
+    // Anything past max_size is dropped, as it would be in a label table.
+    explicit GffLabel(std::string_view text)
+    {
+        char padded[max_size] = {};
+        std::memcpy(padded, text.data(), std::min(text.size(), max_size));
+        m_key[0] = load_be(padded);
+        m_key[1] = load_be(padded + 8);
+    }
+
+    // The label as stored in binary GFF: max_size bytes, null padded and not terminated if it fills them all.
+    void copy_padded(char* out) const
+    {
+        store_be(m_key[0], out);
+        store_be(m_key[1], out + 8);
+    }
+
+    bool operator==(const GffLabel& rhs) const { return m_key[0] == rhs.m_key[0] && m_key[1] == rhs.m_key[1]; }
+    bool operator!=(const GffLabel& rhs) const { return !(*this == rhs); }
+    bool operator<(const GffLabel& rhs) const { return m_key[0] != rhs.m_key[0] ? m_key[0] < rhs.m_key[0] : m_key[1] < rhs.m_key[1]; }
+
+    struct Hash
+    {
+        std::size_t operator()(const GffLabel& label) const
+        {
+            std::uint64_t hash = (label.m_key[0] ^ (label.m_key[1] * 0x9E3779B97F4A7C15ull)) * 0xBF58476D1CE4E5B9ull;
+            return (std::size_t)(hash ^ (hash >> 31));
+        }
+    };
+
+private:
+    static std::uint64_t load_be(const char* bytes)
+    {
+        std::uint64_t value = 0;
+
+        for (std::size_t i = 0; i < 8; ++i)
+        {
+            value = (value << 8) | (unsigned char)bytes[i];
+        }
+
+        return value;
+    }
+
+    static void store_be(std::uint64_t value, char* out)
+    {
+        for (std::size_t i = 0; i < 8; ++i)
+        {
+            out[i] = (char)(value >> (56 - 8 * i));
+        }
+    }
+
+    std::uint64_t m_key[2] = {};
+};
@@ -0,0 +1,587 @@
+#include "GffText.hpp"
+#include "ConvertLog.hpp"
+#include "FieldCodec.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+using namespace FileFormats::Gff;
+using namespace FieldCodecs;
+
+namespace {
+
+constexpr const char* gff_text_magic = "GFFT";
+constexpr int gff_text_version = 1;
+constexpr std::size_t indent_width = 2;
+
+bool is_string_type(Raw::GffField::Type type)
+{
+    return type == Raw::GffField::Type::CExoString || type == Raw::GffField::Type::ResRef;
+}
+
+bool is_bare_char(char ch)
+{
+    return (unsigned char)ch > 0x20 && ch != 0x7F && ch != '"' && ch != '\\';
+}
+
+void append_quoted(std::string_view text, std::string* out)
+{
+    out->push_back('"');
+
+    for (char ch : text)
+    {
+        switch (ch)
+        {
+            case '"': out->append("\\\""); break;
+            case '\\': out->append("\\\\"); break;
+            case '\n': out->append("\\n"); break;
+            case '\r': out->append("\\r"); break;
+            case '\t': out->append("\\t"); break;
+
+            default:
+                if ((unsigned char)ch < 0x20 || ch == 0x7F)
+                {
+                    char hex[8];
+                    std::snprintf(hex, sizeof(hex), "\\x%02X", (unsigned char)ch);
+                    out->append(hex);
+                }
+                else
+                {
+                    out->push_back(ch);
+                }
+                break;
+        }
+    }
+
+    out->push_back('"');
+}
+
+// Labels are almost always plain identifiers, so they only get quoted when they would otherwise be ambiguous.
+void append_token(std::string_view text, std::string* out)
+{
+    if (!text.empty() && std::all_of(std::begin(text), std::end(text), is_bare_char))
+    {
+        out->append(text);
+    }
+    else
+    {
+        append_quoted(text, out);
+    }
+}
+
+struct TextWriteContext
+{
+    XmlSink& sink;
+    const ConvertOptions& options;
+    ConvertReport* report;
+    std::size_t roundtrip_failures;
+    std::string line;
+};
+
+void begin_line(TextWriteContext& ctx, int depth)
+{
+    ctx.line.assign(depth * indent_width, ' ');
+}
+
+void begin_field(TextWriteContext& ctx, int depth, const char* tag, const std::string& label)
+{
+    begin_line(ctx, depth);
+    ctx.line.append(tag);
+    ctx.line.push_back(' ');
+    append_token(label, &ctx.line);
+}
+
+void end_line(TextWriteContext& ctx)
+{
+    ctx.line.push_back('\n');
+    ctx.sink.write(ctx.line.data(), ctx.line.size());
+}
+
+void write_text_r(const Friendly::GffStruct& element, TextWriteContext& ctx, int depth)
+{
+    FormatScratch scratch;
+
+    for (const FieldRef* field : sorted_fields(element))
+    {
+        const FieldRef& kvp = *field;
+        const FieldCodec& codec = codec_for(kvp.second.first);
+
+        if (codec.format)
+        {
+            const char* text = codec.format(element, kvp, &scratch);
+
+            if (ctx.options.verify_roundtrip && !codec.verify(element, kvp, text))
+            {
+                log_msg(ctx.report, "%s %s does not round-trip: wrote '%s'.\n", codec.tag, kvp.first.c_str(), text);
+                ++ctx.roundtrip_failures;
+            }
+
+            begin_field(ctx, depth, codec.tag, kvp.first);
+            ctx.line.push_back(' ');
+
+            if (is_string_type(codec.type))
+            {
+                append_quoted(text, &ctx.line);
+            }
+            else
+            {
+                ctx.line.append(text);
+            }
+
+            end_line(ctx);
+        }
+        else if (codec.type == Raw::GffField::Type::CExoLocString)
+        {
+            Friendly::Type_CExoLocString value;
+            element.ReadField(kvp, &value);
+
+            begin_field(ctx, depth, codec.tag, kvp.first);
+            ctx.line.push_back(' ');
+            ctx.line.append(format_value(value.m_StringRef, &scratch));
+            end_line(ctx);
+
+            for (const Friendly::Type_CExoLocString::SubString& substring : value.m_SubStrings)
+            {
+                begin_line(ctx, depth + 1);
+                ctx.line.append(format_value(substring.m_StringID, &scratch));
+                ctx.line.push_back(' ');
+                append_quoted(substring.m_String, &ctx.line);
+                end_line(ctx);
+            }
+        }
+        else if (codec.type == Raw::GffField::Type::VOID)
+        {
+            log_msg(ctx.report, "VOID data detected in %s. Dropping.\n", kvp.first.c_str());
+        }
+        else if (codec.type == Raw::GffField::Type::Struct)
+        {
+            Friendly::Type_Struct value;
+            element.ReadField(kvp, &value);
+
+            begin_field(ctx, depth, codec.tag, kvp.first);
+            ctx.line.push_back(' ');
+            ctx.line.append(format_value(value.GetUserDefinedId(), &scratch));
+            end_line(ctx);
+
+            write_text_r(value, ctx, depth + 1);
+        }
+        else if (codec.type == Raw::GffField::Type::List)
+        {
+            Friendly::Type_List value;
+            element.ReadField(kvp, &value);
+
+            begin_field(ctx, depth, codec.tag, kvp.first);
+            end_line(ctx);
+
+            for (const Friendly::GffStruct& struc : value.GetStructs())
+            {
+                begin_line(ctx, depth + 1);
+                ctx.line.append("- ");
+                ctx.line.append(format_value(struc.GetUserDefinedId(), &scratch));
+                end_line(ctx);
+
+                write_text_r(struc, ctx, depth + 2);
+            }
+        }
+        else
+        {
+            ASSERT_FAIL();
+        }
+    }
+}
+
+// Splits one line (indentation already removed) into space-separated words and quoted strings.
+class LineCursor
+{
+public:
+    explicit LineCursor(std::string_view line)
+        : m_rest(line)
+    { }
+
+    bool at_end()
+    {
+        skip_spaces();
+        return m_rest.empty();
+    }
+
+    bool word(std::string_view* out)
+    {
+        skip_spaces();
+        if (m_rest.empty()) return false;
+
+        std::size_t len = std::min(m_rest.find(' '), m_rest.size());
+        *out = m_rest.substr(0, len);
+        m_rest.remove_prefix(len);
+        return true;
+    }
+
+    // Either a bare word or a quoted string, with escapes resolved.
+    bool token(std::string* out)
+    {
+        skip_spaces();
+        if (m_rest.empty()) return false;
+        if (m_rest.front() != '"')
+        {
+            std::string_view bare;
+            word(&bare);
+            out->assign(bare);
+            return true;
+        }
+
+        out->clear();
+        m_rest.remove_prefix(1);
+
+        while (!m_rest.empty())
+        {
+            char ch = m_rest.front();
+            m_rest.remove_prefix(1);
+
+            if (ch == '"')
+            {
+                // The closing quote must end the token.
+                return m_rest.empty() || m_rest.front() == ' ';
+            }
+
+            if (ch != '\\')
+            {
+                out->push_back(ch);
+                continue;
+            }
+
+            if (m_rest.empty()) return false;
+            char escape = m_rest.front();
+            m_rest.remove_prefix(1);
+
+            switch (escape)
+            {
+                case '"': out->push_back('"'); break;
+                case '\\': out->push_back('\\'); break;
+                case 'n': out->push_back('\n'); break;
+                case 'r': out->push_back('\r'); break;
+                case 't': out->push_back('\t'); break;
+
+                case 'x':
+                {
+                    std::uint8_t value;
+                    if (m_rest.size() < 2) return false;
+                    auto [end, ec] = std::from_chars(m_rest.data(), m_rest.data() + 2, value, 16);
+                    if (ec != std::errc() || end != m_rest.data() + 2) return false;
+                    out->push_back((char)value);
+                    m_rest.remove_prefix(2);
+                    break;
+                }
+
+                default:
+                    return false;
+            }
+        }
+
+        return false; // Unterminated.
+    }
+
+private:
+    void skip_spaces()
+    {
+        while (!m_rest.empty() && m_rest.front() == ' ') m_rest.remove_prefix(1);
+    }
+
+    std::string_view m_rest;
+};
+
+// A struct, list or localized string whose contents are the following, more deeply indented, lines.
+struct Frame
+{
+    enum class Kind
+    {
+        Struct,
+        List,
+        LocString
+    };
+
+    Kind kind;
+    std::string label; // Label in the enclosing struct; empty for list elements and the top level struct.
+    Friendly::GffStruct struc;
+    Friendly::Type_List list;
+    Friendly::Type_CExoLocString loc;
+};
+
+class GffTextReader
+{
+public:
+    GffTextReader(Friendly::Gff* out)
+        : m_out(out), m_line(0)
+    { }
+
+    bool read(const char* data, std::size_t len)
+    {
+        const char* pos = data;
+        const char* end = data + len;
+
+        // Skip a UTF-8 BOM in case an editor added one.
+        if (len >= 3 && std::memcmp(pos, "\xEF\xBB\xBF", 3) == 0)
+        {
+            pos += 3;
+        }
+
+        while (pos != end)
+        {
+            ++m_line;
+            const char* eol = std::find(pos, end, '\n');
+            std::string_view line(pos, eol - pos);
+            pos = eol == end ? end : eol + 1;
+
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.remove_suffix(1);
+            }
+
+            std::size_t indent = line.find_first_not_of(' ');
+            if (indent == std::string_view::npos || line[indent] == '#') continue;
+
+            LineCursor cursor(line.substr(indent));
+
+            if (m_stack.empty())
+            {
+                if (indent != 0 || !read_header(cursor)) return false;
+                continue;
+            }
+
+            if (indent % indent_width != 0) return fail("Indentation is not a multiple of two spaces.");
+
+            std::size_t depth = indent / indent_width;
+            if (depth >= m_stack.size()) return fail("Unexpected indentation.");
+
+            while (m_stack.size() > depth + 1)
+            {
+                close_frame();
+            }
+
+            bool success = false;
+
+            switch (m_stack.back().kind)
+            {
+                case Frame::Kind::Struct: success = read_field(cursor, depth); break;
+                case Frame::Kind::List: success = read_list_element(cursor); break;
+                case Frame::Kind::LocString: success = read_substring(cursor); break;
+            }
+
+            if (!success) return false;
+        }
+
+        if (m_stack.empty()) return fail("Missing GFFT header.");
+
+        while (m_stack.size() > 1)
+        {
+            close_frame();
+        }
+
+        return true;
+    }
+
+    const std::string& error() const
+    {
+        return m_error;
+    }
+
+private:
+    bool fail(const char* message)
+    {
+        m_error = "Line " + std::to_string(std::max<std::size_t>(m_line, 1)) + ": " + message;
+        return false;
+    }
+
+    // The top level struct is filled in place; everything below it lives in its frame until complete.
+    Friendly::GffStruct& struct_at(std::size_t depth)
+    {
+        return depth == 0 ? m_out->GetTopLevelStruct() : m_stack[depth].struc;
+    }
+
+    bool read_header(LineCursor& cursor)
+    {
+        std::string_view magic;
+        std::string_view version_text;
+        std::string_view type;
+        int version;
+
+        if (!cursor.word(&magic) || magic != gff_text_magic) return fail("Expected a GFFT header.");
+        if (!cursor.word(&version_text) || !parse_value(version_text, &version)) return fail("Malformed GFFT version.");
+        if (version != gff_text_version) return fail("Unsupported GFFT version.");
+        if (!cursor.word(&type) || type.size() < 3 || !cursor.at_end()) return fail("Malformed GFFT file type.");
+
+        char* file_type = m_out->GetFileType();
+        std::memcpy(file_type, type.data(), 3);
+        file_type[3] = ' ';
+
+        // Same as the XML reader, which has no Id for the top level struct either.
+        m_out->GetTopLevelStruct().SetUserDefinedId(0);
+
+        m_stack.emplace_back().kind = Frame::Kind::Struct;
+        return true;
+    }
+
+    bool read_field(LineCursor& cursor, std::size_t depth)
+    {
+        std::string_view tag;
+        std::string label;
+
+        if (!cursor.word(&tag)) return fail("Expected a field.");
+
+        const FieldCodec* codec = find_codec(tag);
+        if (!codec) return fail("Unknown field type.");
+        if (!cursor.token(&label)) return fail("Field is missing its label.");
+        if (label.size() > GffLabel::max_size) return fail("Field label is longer than 16 characters.");
+
+        if (codec->parse)
+        {
+            std::string_view text;
+            std::string string_text;
+
+            if (is_string_type(codec->type))
+            {
+                if (!cursor.token(&string_text)) return fail("Malformed string value.");
+                text = string_text;
+            }
+            else if (!cursor.word(&text))
+            {
+                return fail("Field is missing its value.");
+            }
+
+            if (!cursor.at_end()) return fail("Unexpected text after field value.");
+            if (!codec->parse(text, label.c_str(), &struct_at(depth))) return fail("Malformed field value.");
+            return true;
+        }
+
+        if (codec->type == Raw::GffField::Type::CExoLocString)
+        {
+            std::string_view text;
+            std::uint32_t string_ref;
+
+            if (!cursor.word(&text) || !parse_value(text, &string_ref) || !cursor.at_end())
+            {
+                return fail("Malformed StringRef.");
+            }
+
+            Frame& frame = push_frame(Frame::Kind::LocString, std::move(label));
+            frame.loc.m_StringRef = string_ref;
+            frame.loc.m_TotalSize = sizeof(frame.loc.m_StringRef) + sizeof(std::uint32_t); // string count
+            return true;
+        }
+
+        if (codec->type == Raw::GffField::Type::Struct)
+        {
+            std::uint32_t id;
+            if (!read_id(cursor, &id)) return false;
+            push_frame(Frame::Kind::Struct, std::move(label)).struc.SetUserDefinedId(id);
+            return true;
+        }
+
+        if (codec->type == Raw::GffField::Type::List)
+        {
+            if (!cursor.at_end()) return fail("Unexpected text after list label.");
+            push_frame(Frame::Kind::List, std::move(label));
+            return true;
+        }
+
+        return fail("Unknown field type.");
+    }
+
+    bool read_list_element(LineCursor& cursor)
+    {
+        std::string_view dash;
+        std::uint32_t id;
+
+        if (!cursor.word(&dash) || dash != "-") return fail("Expected a list element.");
+        if (!read_id(cursor, &id)) return false;
+
+        push_frame(Frame::Kind::Struct, {}).struc.SetUserDefinedId(id);
+        return true;
+    }
+
+    bool read_substring(LineCursor& cursor)
+    {
+        std::string_view id_text;
+        Friendly::Type_CExoLocString::SubString ss;
+
+        if (!cursor.word(&id_text) || !parse_value(id_text, &ss.m_StringID)) return fail("Malformed substring id.");
+        if (!cursor.token(&ss.m_String) || !cursor.at_end()) return fail("Malformed substring.");
+
+        Friendly::Type_CExoLocString& loc = m_stack.back().loc;
+        loc.m_TotalSize += sizeof(ss.m_StringID) + sizeof(std::uint32_t) + (std::uint32_t)ss.m_String.size();
+        loc.m_SubStrings.emplace_back(std::move(ss));
+        return true;
+    }
+
+    bool read_id(LineCursor& cursor, std::uint32_t* out)
+    {
+        // Parsed wide and truncated, as the XML reader does, so -1 means 0xFFFFFFFF in both.
+        std::string_view text;
+        std::int64_t id;
+        if (!cursor.word(&text) || !parse_value(text, &id) || !cursor.at_end()) return fail("Malformed struct id.");
+        *out = (std::uint32_t)id;
+        return true;
+    }
+
+    Frame& push_frame(Frame::Kind kind, std::string label)
+    {
+        Frame& frame = m_stack.emplace_back();
+        frame.kind = kind;
+        frame.label = std::move(label);
+        return frame;
+    }
+
+    // Hands the innermost frame's contents to its parent once no more lines can belong to it.
+    void close_frame()
+    {
+        Frame frame = std::move(m_stack.back());
+        m_stack.pop_back();
+
+        if (m_stack.back().kind == Frame::Kind::List)
+        {
+            m_stack.back().list.GetStructs().emplace_back(std::move(frame.struc));
+            return;
+        }
+
+        Friendly::GffStruct& parent = struct_at(m_stack.size() - 1);
+
+        switch (frame.kind)
+        {
+            case Frame::Kind::Struct: parent.WriteField(frame.label.c_str(), std::move(frame.struc)); break;
+            case Frame::Kind::List: parent.WriteField(frame.label.c_str(), std::move(frame.list)); break;
+            case Frame::Kind::LocString: parent.WriteField(frame.label.c_str(), std::move(frame.loc)); break;
+        }
+    }
+
+    Friendly::Gff* m_out;
+    std::vector<Frame> m_stack;
+    std::size_t m_line;
+    std::string m_error;
+};
+
+}
+
+bool read_gff_text(const char* data, std::size_t len, Friendly::Gff* out, std::string* error)
+{
+    GffTextReader reader(out);
+    if (reader.read(data, len)) return true;
+    *error = reader.error();
+    return false;
+}
+
+std::size_t write_gff_text(const Friendly::Gff& gff, XmlSink* sink, const ConvertOptions& options, ConvertReport* report)
+{
+    TextWriteContext ctx { *sink, options, report, 0, {} };
+
+    ctx.line = gff_text_magic;
+    ctx.line.push_back(' ');
+    ctx.line.append(std::to_string(gff_text_version));
+    ctx.line.push_back(' ');
+    ctx.line.append(gff.GetFileType(), 3);
+    end_line(ctx);
+
+    write_text_r(gff.GetTopLevelStruct(), ctx, 0);
+    return ctx.roundtrip_failures;
+}
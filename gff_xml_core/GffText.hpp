@@ -0,0 +1,36 @@
+#pragma once
+
+#include "GffXml.hpp"
+#include "XmlWriter.hpp"
+#include "FileFormats/Gff.hpp"
+
+#include <cstddef>
+#include <string>
+
+// GFF text (.gfft) - a compact, line-oriented alternative to the XML form. One field per line, nesting by
+// indentation (two spaces per level), so it diffs and merges line by line like the XML does at a fraction of the
+// size. The reader works a line at a time with no lookahead and no intermediate tree.
+//
+//   GFFT 1 UTC
+//   Byte Appearance 200
+//   CExoString Tag "nw_\"quoted\"\n"
+//   CExoLocString FirstName 4294967295
+//     0 "Aribeth"
+//   Struct Stats 7
+//     Int Str -5
+//   List ItemList
+//     - 0
+//       ResRef InventoryRes "nw_it_gold001"
+//
+// Field lines are <type> <label> <value>, with type names and value formatting shared with the XML (FieldCodec.hpp).
+// Strings are double-quoted with C-style escapes; labels are bare unless they need quoting. Struct lines carry the
+// struct's id, list elements are "- <id>" and localized strings carry their StringRef followed by one
+// "<id> <string>" line per substring. Blank lines and lines starting with # are ignored.
+
+// Reads a .gfft document into out. On failure, error holds a "Line N: ..." description.
+bool read_gff_text(const char* data, std::size_t len, FileFormats::Gff::Friendly::Gff* out, std::string* error);
+
+// Writes gff as .gfft text. Returns the number of fields that failed round-trip verification, which is always zero
+// unless options.verify_roundtrip is set; each failure is logged to report.
+std::size_t write_gff_text(const FileFormats::Gff::Friendly::Gff& gff, XmlSink* sink,
+    const ConvertOptions& options, ConvertReport* report);
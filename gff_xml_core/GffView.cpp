@@ -0,0 +1,773 @@
+#include "GffView.hpp"
+#include "FieldCodec.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace FileFormats::Gff;
+
+namespace {
+
+// Header layout: FileType[4], FileVersion[4], then an offset and count for each of the six tables.
+constexpr std::size_t header_size = 56;
+constexpr std::size_t struct_entry_size = 12;
+constexpr std::size_t field_entry_size = 12;
+constexpr std::size_t label_size = 16;
+
+std::uint32_t read_u32(const std::byte* pos)
+{
+    std::uint32_t value;
+    std::memcpy(&value, pos, sizeof(value));
+    return value;
+}
+
+bool is_simple_type(Raw::GffField::Type type)
+{
+    switch (type)
+    {
+        case Raw::GffField::Type::BYTE:
+        case Raw::GffField::Type::CHAR:
+        case Raw::GffField::Type::WORD:
+        case Raw::GffField::Type::SHORT:
+        case Raw::GffField::Type::DWORD:
+        case Raw::GffField::Type::INT:
+        case Raw::GffField::Type::FLOAT:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+}
+
+bool GffView::open(const std::byte* data, std::size_t len)
+{
+    m_data = data;
+    m_len = len;
+
+    if (len < header_size) return fail("File is too small to be a GFF.");
+    if (std::memcmp(data + 4, "V3.2", 4) != 0) return fail("Unsupported GFF version.");
+
+    Table* tables[] = { &m_structs, &m_fields, &m_labels, &m_field_data, &m_field_indices, &m_list_indices };
+    std::size_t entry_sizes[] = { struct_entry_size, field_entry_size, label_size, 1, 1, 1 };
+
+    for (std::size_t i = 0; i < 6; ++i)
+    {
+        tables[i]->offset = read_u32(data + 8 + i * 8);
+        tables[i]->count = read_u32(data + 12 + i * 8);
+
+        if ((std::uint64_t)tables[i]->offset + (std::uint64_t)tables[i]->count * entry_sizes[i] > len)
+        {
+            return fail("GFF table extends past the end of the file.");
+        }
+    }
+
+    if (m_structs.count == 0) return fail("GFF has no top level struct.");
+    return true;
+}
+
+bool GffView::get_struct(std::uint32_t index, GffStructView* out) const
+{
+    if (index >= m_structs.count) return fail("Struct index out of range.");
+
+    const std::byte* entry = m_data + m_structs.offset + (std::size_t)index * struct_entry_size;
+    out->m_view = this;
+    out->m_index = index;
+    out->m_id = read_u32(entry);
+    out->m_data = read_u32(entry + 4);
+    out->m_field_count = read_u32(entry + 8);
+    return true;
+}
+
+bool GffView::field_data(const GffFieldView& field, const std::byte** data, std::size_t* len) const
+{
+    std::uint64_t size;
+
+    switch (field.type())
+    {
+        case Raw::GffField::Type::DWORD64:
+        case Raw::GffField::Type::INT64:
+        case Raw::GffField::Type::DOUBLE:
+            size = 8;
+            break;
+
+        case Raw::GffField::Type::ResRef:
+        {
+            const std::byte* prefix = table_bytes(m_field_data, field.m_data, 1);
+            if (!prefix) return false;
+            size = 1 + (std::uint64_t)*prefix;
+            break;
+        }
+
+        case Raw::GffField::Type::CExoString:
+        case Raw::GffField::Type::CExoLocString:
+        case Raw::GffField::Type::VOID:
+        {
+            // All three lead with the byte count of what follows.
+            const std::byte* prefix = table_bytes(m_field_data, field.m_data, 4);
+            if (!prefix) return false;
+            size = 4 + (std::uint64_t)read_u32(prefix);
+            break;
+        }
+
+        default:
+            return fail("Field has no data in the field data table.");
+    }
+
+    *data = table_bytes(m_field_data, field.m_data, size);
+    *len = (std::size_t)size;
+    return *data != nullptr;
+}
+
+bool GffView::fail(const char* message) const
+{
+    m_error = message;
+    return false;
+}
+
+bool GffView::get_field(std::uint32_t index, GffFieldView* out) const
+{
+    if (index >= m_fields.count) return fail("Field index out of range.");
+
+    const std::byte* entry = m_data + m_fields.offset + (std::size_t)index * field_entry_size;
+    std::uint32_t label_index = read_u32(entry + 4);
+    if (label_index >= m_labels.count) return fail("Label index out of range.");
+
+    // Labels are 16 bytes, null-padded but not necessarily null-terminated.
+    const char* label = reinterpret_cast<const char*>(m_data + m_labels.offset + (std::size_t)label_index * label_size);
+
+    out->m_view = this;
+    out->m_type = (Raw::GffField::Type)read_u32(entry);
+    out->m_label = std::string_view(label, std::find(label, label + label_size, '\0') - label);
+    out->m_data = read_u32(entry + 8);
+
+    if ((std::uint32_t)out->m_type > (std::uint32_t)Raw::GffField::Type::List) return fail("Unknown field type.");
+    return true;
+}
+
+const std::byte* GffView::table_bytes(const Table& table, std::uint64_t offset, std::uint64_t len) const
+{
+    if (offset + len > table.count)
+    {
+        fail("GFF data out of range.");
+        return nullptr;
+    }
+
+    return m_data + table.offset + offset;
+}
+
+bool GffStructView::field(std::uint32_t i, GffFieldView* out) const
+{
+    if (i >= m_field_count) return m_view->fail("Field index out of range.");
+    if (m_field_count == 1) return m_view->get_field(m_data, out);
+
+    const std::byte* index = m_view->table_bytes(m_view->m_field_indices, (std::uint64_t)m_data + (std::uint64_t)i * 4, 4);
+    return index && m_view->get_field(read_u32(index), out);
+}
+
+bool GffStructView::find(std::string_view label, GffFieldView* out) const
+{
+    for (std::uint32_t i = 0; i < m_field_count; ++i)
+    {
+        if (!field(i, out)) return false;
+        if (out->label() == label) return true;
+    }
+
+    return false;
+}
+
+bool GffListView::at(std::uint32_t i, GffStructView* out) const
+{
+    if (i >= m_size) return m_view->fail("List index out of range.");
+    return m_view->get_struct(read_u32(m_indices + (std::size_t)i * 4), out);
+}
+
+template <typename T>
+bool GffFieldView::read_simple(Raw::GffField::Type type, T* out) const
+{
+    // Values of four bytes or less live in the field entry itself, in its low-order bytes.
+    if (m_type != type) return m_view->fail("Field type mismatch.");
+    std::memcpy(out, &m_data, sizeof(T));
+    return true;
+}
+
+template <typename T>
+bool GffFieldView::read_complex(Raw::GffField::Type type, T* out) const
+{
+    if (m_type != type) return m_view->fail("Field type mismatch.");
+    const std::byte* bytes = m_view->table_bytes(m_view->m_field_data, m_data, sizeof(T));
+    if (!bytes) return false;
+    std::memcpy(out, bytes, sizeof(T));
+    return true;
+}
+
+bool GffFieldView::read(Friendly::Type_BYTE* out) const { return read_simple(Raw::GffField::Type::BYTE, out); }
+bool GffFieldView::read(Friendly::Type_CHAR* out) const { return read_simple(Raw::GffField::Type::CHAR, out); }
+bool GffFieldView::read(Friendly::Type_WORD* out) const { return read_simple(Raw::GffField::Type::WORD, out); }
+bool GffFieldView::read(Friendly::Type_SHORT* out) const { return read_simple(Raw::GffField::Type::SHORT, out); }
+bool GffFieldView::read(Friendly::Type_DWORD* out) const { return read_simple(Raw::GffField::Type::DWORD, out); }
+bool GffFieldView::read(Friendly::Type_INT* out) const { return read_simple(Raw::GffField::Type::INT, out); }
+bool GffFieldView::read(Friendly::Type_FLOAT* out) const { return read_simple(Raw::GffField::Type::FLOAT, out); }
+bool GffFieldView::read(Friendly::Type_DWORD64* out) const { return read_complex(Raw::GffField::Type::DWORD64, out); }
+bool GffFieldView::read(Friendly::Type_INT64* out) const { return read_complex(Raw::GffField::Type::INT64, out); }
+bool GffFieldView::read(Friendly::Type_DOUBLE* out) const { return read_complex(Raw::GffField::Type::DOUBLE, out); }
+
+bool GffFieldView::read(Friendly::Type_CExoString* out) const
+{
+    const std::byte* data;
+    std::size_t len;
+
+    if (m_type != Raw::GffField::Type::CExoString) return m_view->fail("Field type mismatch.");
+    if (!m_view->field_data(*this, &data, &len)) return false;
+
+    out->m_String.assign(reinterpret_cast<const char*>(data + 4), len - 4);
+    return true;
+}
+
+bool GffFieldView::read(Friendly::Type_CResRef* out) const
+{
+    const std::byte* data;
+    std::size_t len;
+
+    if (m_type != Raw::GffField::Type::ResRef) return m_view->fail("Field type mismatch.");
+    if (!m_view->field_data(*this, &data, &len)) return false;
+    if (len - 1 > sizeof(out->m_String)) return m_view->fail("ResRef is longer than 16 characters.");
+
+    std::memset(out->m_String, 0, sizeof(out->m_String));
+    std::memcpy(out->m_String, data + 1, len - 1);
+    out->m_Size = (std::uint8_t)(len - 1);
+    return true;
+}
+
+bool GffFieldView::read(Friendly::Type_CExoLocString* out) const
+{
+    const std::byte* data;
+    std::size_t len;
+
+    if (m_type != Raw::GffField::Type::CExoLocString) return m_view->fail("Field type mismatch.");
+    if (!m_view->field_data(*this, &data, &len)) return false;
+    if (len < 12) return m_view->fail("CExoLocString data out of range.");
+
+    out->m_TotalSize = read_u32(data);
+    out->m_StringRef = read_u32(data + 4);
+    std::uint32_t count = read_u32(data + 8);
+    std::size_t pos = 12;
+
+    out->m_SubStrings.clear();
+
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        if (len - pos < 8) return m_view->fail("CExoLocString substring out of range.");
+
+        Friendly::Type_CExoLocString::SubString ss;
+        std::memcpy(&ss.m_StringID, data + pos, sizeof(ss.m_StringID));
+        std::uint32_t size = read_u32(data + pos + 4);
+        pos += 8;
+
+        if (len - pos < size) return m_view->fail("CExoLocString substring out of range.");
+
+        ss.m_String.assign(reinterpret_cast<const char*>(data + pos), size);
+        out->m_SubStrings.emplace_back(std::move(ss));
+        pos += size;
+    }
+
+    return true;
+}
+
+bool GffFieldView::read(Friendly::Type_VOID* out) const
+{
+    const std::byte* data;
+    std::size_t len;
+
+    if (m_type != Raw::GffField::Type::VOID) return m_view->fail("Field type mismatch.");
+    if (!m_view->field_data(*this, &data, &len)) return false;
+
+    out->m_Data.assign(data + 4, data + len);
+    return true;
+}
+
+bool GffFieldView::read(GffStructView* out) const
+{
+    if (m_type != Raw::GffField::Type::Struct) return m_view->fail("Field type mismatch.");
+    return m_view->get_struct(m_data, out);
+}
+
+bool GffFieldView::read(GffListView* out) const
+{
+    if (m_type != Raw::GffField::Type::List) return m_view->fail("Field type mismatch.");
+
+    const std::byte* count = m_view->table_bytes(m_view->m_list_indices, m_data, 4);
+    if (!count) return false;
+
+    std::uint32_t size = read_u32(count);
+    const std::byte* indices = m_view->table_bytes(m_view->m_list_indices, (std::uint64_t)m_data + 4, (std::uint64_t)size * 4);
+    if (!indices) return false;
+
+    out->m_view = m_view;
+    out->m_indices = indices;
+    out->m_size = size;
+    return true;
+}
+
+namespace {
+
+// Lays out a fresh binary GFF. Structs and fields are appended in visiting order; a struct's field index list can
+// only be written once all of its fields (and therefore all of their children) have been added.
+class GffBuilder
+{
+public:
+    std::uint32_t add_struct(std::uint32_t id)
+    {
+        m_structs.push_back({ id, 0, 0 });
+        return (std::uint32_t)m_structs.size() - 1;
+    }
+
+    void set_struct_fields(std::uint32_t index, const std::vector<std::uint32_t>& fields)
+    {
+        Entry& entry = m_structs[index];
+        entry.c = (std::uint32_t)fields.size();
+
+        if (fields.size() == 1)
+        {
+            entry.b = fields[0];
+        }
+        else if (!fields.empty())
+        {
+            entry.b = (std::uint32_t)m_field_indices.size();
+            append(&m_field_indices, fields.data(), fields.size() * 4);
+        }
+    }
+
+    std::uint32_t reserve_field()
+    {
+        m_fields.push_back({});
+        return (std::uint32_t)m_fields.size() - 1;
+    }
+
+    void set_field(std::uint32_t index, Raw::GffField::Type type, std::string_view label, std::uint32_t data)
+    {
+        m_fields[index] = { (std::uint32_t)type, add_label(label), data };
+    }
+
+    std::uint32_t add_data(const void* data, std::size_t len)
+    {
+        std::uint32_t offset = (std::uint32_t)m_field_data.size();
+        append(&m_field_data, data, len);
+        return offset;
+    }
+
+    std::uint32_t add_list(const std::vector<std::uint32_t>& structs)
+    {
+        std::uint32_t offset = (std::uint32_t)m_list_indices.size();
+        std::uint32_t count = (std::uint32_t)structs.size();
+        append(&m_list_indices, &count, 4);
+        append(&m_list_indices, structs.data(), structs.size() * 4);
+        return offset;
+    }
+
+    // Encodes a Friendly struct, and everything below it, as a new struct.
+    std::uint32_t add_friendly_struct(const Friendly::GffStruct& struc)
+    {
+        std::uint32_t index = add_struct(struc.GetUserDefinedId());
+        std::vector<std::uint32_t> fields;
+
+        for (const FieldCodecs::FieldRef* kvp : FieldCodecs::sorted_fields(struc))
+        {
+            fields.push_back(add_friendly_field(struc, *kvp));
+        }
+
+        set_struct_fields(index, fields);
+        return index;
+    }
+
+    std::uint32_t add_friendly_field(const Friendly::GffStruct& owner, const FieldCodecs::FieldRef& kvp)
+    {
+        std::uint32_t index = reserve_field();
+        Raw::GffField::Type type = kvp.second.first;
+        std::uint32_t data = 0;
+
+        switch (type)
+        {
+            case Raw::GffField::Type::BYTE: data = simple<Friendly::Type_BYTE>(owner, kvp); break;
+            case Raw::GffField::Type::CHAR: data = simple<Friendly::Type_CHAR>(owner, kvp); break;
+            case Raw::GffField::Type::WORD: data = simple<Friendly::Type_WORD>(owner, kvp); break;
+            case Raw::GffField::Type::SHORT: data = simple<Friendly::Type_SHORT>(owner, kvp); break;
+            case Raw::GffField::Type::DWORD: data = simple<Friendly::Type_DWORD>(owner, kvp); break;
+            case Raw::GffField::Type::INT: data = simple<Friendly::Type_INT>(owner, kvp); break;
+            case Raw::GffField::Type::FLOAT: data = simple<Friendly::Type_FLOAT>(owner, kvp); break;
+            case Raw::GffField::Type::DWORD64: data = complex<Friendly::Type_DWORD64>(owner, kvp); break;
+            case Raw::GffField::Type::INT64: data = complex<Friendly::Type_INT64>(owner, kvp); break;
+            case Raw::GffField::Type::DOUBLE: data = complex<Friendly::Type_DOUBLE>(owner, kvp); break;
+
+            case Raw::GffField::Type::CExoString:
+            {
+                Friendly::Type_CExoString value;
+                owner.ReadField(kvp, &value);
+                std::uint32_t size = (std::uint32_t)value.m_String.size();
+                data = add_data(&size, 4);
+                add_data(value.m_String.data(), size);
+                break;
+            }
+
+            case Raw::GffField::Type::ResRef:
+            {
+                Friendly::Type_CResRef value;
+                owner.ReadField(kvp, &value);
+                std::uint8_t size = std::min<std::uint8_t>(value.m_Size, sizeof(value.m_String));
+                data = add_data(&size, 1);
+                add_data(value.m_String, size);
+                break;
+            }
+
+            case Raw::GffField::Type::CExoLocString:
+            {
+                Friendly::Type_CExoLocString value;
+                owner.ReadField(kvp, &value);
+
+                // Recomputed rather than trusted, as it is easy for an edit to leave m_TotalSize stale.
+                std::uint32_t total = 8;
+
+                for (const Friendly::Type_CExoLocString::SubString& ss : value.m_SubStrings)
+                {
+                    total += 8 + (std::uint32_t)ss.m_String.size();
+                }
+
+                std::uint32_t count = (std::uint32_t)value.m_SubStrings.size();
+                data = add_data(&total, 4);
+                add_data(&value.m_StringRef, 4);
+                add_data(&count, 4);
+
+                for (const Friendly::Type_CExoLocString::SubString& ss : value.m_SubStrings)
+                {
+                    std::uint32_t size = (std::uint32_t)ss.m_String.size();
+                    add_data(&ss.m_StringID, 4);
+                    add_data(&size, 4);
+                    add_data(ss.m_String.data(), size);
+                }
+
+                break;
+            }
+
+            case Raw::GffField::Type::VOID:
+            {
+                Friendly::Type_VOID value;
+                owner.ReadField(kvp, &value);
+                std::uint32_t size = (std::uint32_t)value.m_Data.size();
+                data = add_data(&size, 4);
+                add_data(value.m_Data.data(), size);
+                break;
+            }
+
+            case Raw::GffField::Type::Struct:
+            {
+                Friendly::Type_Struct value;
+                owner.ReadField(kvp, &value);
+                data = add_friendly_struct(value);
+                break;
+            }
+
+            case Raw::GffField::Type::List:
+            {
+                Friendly::Type_List value;
+                owner.ReadField(kvp, &value);
+                std::vector<std::uint32_t> structs;
+
+                for (const Friendly::GffStruct& child : value.GetStructs())
+                {
+                    structs.push_back(add_friendly_struct(child));
+                }
+
+                data = add_list(structs);
+                break;
+            }
+        }
+
+        set_field(index, type, kvp.first, data);
+        return index;
+    }
+
+    void finish(const char* file_type, std::vector<std::byte>* out) const
+    {
+        const std::vector<std::byte>* blobs[] = { &m_field_data, &m_field_indices, &m_list_indices };
+        std::uint32_t counts[] =
+        {
+            (std::uint32_t)m_structs.size(), (std::uint32_t)m_fields.size(), (std::uint32_t)m_labels.size(),
+            (std::uint32_t)m_field_data.size(), (std::uint32_t)m_field_indices.size(), (std::uint32_t)m_list_indices.size()
+        };
+        std::size_t sizes[] =
+        {
+            m_structs.size() * struct_entry_size, m_fields.size() * field_entry_size, m_labels.size() * label_size,
+            m_field_data.size(), m_field_indices.size(), m_list_indices.size()
+        };
+
+        out->clear();
+        out->reserve(header_size + sizes[0] + sizes[1] + sizes[2] + sizes[3] + sizes[4] + sizes[5]);
+
+        append(out, file_type, 4);
+        append(out, "V3.2", 4);
+
+        std::uint32_t offset = (std::uint32_t)header_size;
+
+        for (std::size_t i = 0; i < 6; ++i)
+        {
+            append(out, &offset, 4);
+            append(out, &counts[i], 4);
+            offset += (std::uint32_t)sizes[i];
+        }
+
+        append(out, m_structs.data(), sizes[0]);
+        append(out, m_fields.data(), sizes[1]);
+
+        for (const GffLabel& label : m_labels)
+        {
+            char padded[label_size];
+            label.copy_padded(padded);
+            append(out, padded, label_size);
+        }
+
+        for (const std::vector<std::byte>* blob : blobs)
+        {
+            append(out, blob->data(), blob->size());
+        }
+    }
+
+private:
+    struct Entry
+    {
+        std::uint32_t a;
+        std::uint32_t b;
+        std::uint32_t c;
+    };
+
+    static_assert(sizeof(Entry) == 12);
+
+    static void append(std::vector<std::byte>* out, const void* data, std::size_t len)
+    {
+        const std::byte* bytes = static_cast<const std::byte*>(data);
+        out->insert(std::end(*out), bytes, bytes + len);
+    }
+
+    template <typename T>
+    std::uint32_t simple(const Friendly::GffStruct& owner, const FieldCodecs::FieldRef& kvp)
+    {
+        T value;
+        owner.ReadField(kvp, &value);
+        std::uint32_t data = 0;
+        std::memcpy(&data, &value, sizeof(T));
+        return data;
+    }
+
+    template <typename T>
+    std::uint32_t complex(const Friendly::GffStruct& owner, const FieldCodecs::FieldRef& kvp)
+    {
+        T value;
+        owner.ReadField(kvp, &value);
+        return add_data(&value, sizeof(T));
+    }
+
+    std::uint32_t add_label(std::string_view text)
+    {
+        GffLabel label(text);
+        auto [iter, inserted] = m_label_indices.try_emplace(label, (std::uint32_t)m_labels.size());
+
+        if (inserted)
+        {
+            m_labels.push_back(label);
+        }
+
+        return iter->second;
+    }
+
+    std::vector<Entry> m_structs;
+    std::vector<Entry> m_fields;
+    std::vector<GffLabel> m_labels;
+    std::unordered_map<GffLabel, std::uint32_t, GffLabel::Hash> m_label_indices;
+    std::vector<std::byte> m_field_data;
+    std::vector<std::byte> m_field_indices;
+    std::vector<std::byte> m_list_indices;
+};
+
+}
+
+GffEdit::GffEdit(const GffView* base)
+    : m_base(base)
+{
+    std::memcpy(m_file_type, base ? base->file_type() : "GFF ", 4);
+}
+
+void GffEdit::set_file_type(const char* type)
+{
+    std::memcpy(m_file_type, type, 4);
+}
+
+Friendly::GffStruct& GffEdit::edit_struct(std::uint32_t struct_index)
+{
+    return m_edits[struct_index].set;
+}
+
+void GffEdit::remove_field(std::uint32_t struct_index, const char* label)
+{
+    m_edits[struct_index].removed.emplace(std::string_view(label));
+}
+
+namespace {
+
+class EditWriter
+{
+public:
+    EditWriter(const GffView& base, const std::unordered_map<std::uint32_t, GffEdit::StructEdit>& edits, GffBuilder* out)
+        : m_base(base), m_edits(edits), m_out(out), m_active(base.struct_count(), false)
+    { }
+
+    bool copy_struct(const GffStructView& struc, std::uint32_t* out)
+    {
+        // Structs nest by index, so a corrupt file could loop back on itself.
+        if (m_active[struc.index()]) return fail("Struct contains itself.");
+        m_active[struc.index()] = true;
+
+        *out = m_out->add_struct(struc.id());
+
+        auto edit_iter = m_edits.find(struc.index());
+        const GffEdit::StructEdit* edit = edit_iter == std::end(m_edits) ? nullptr : &edit_iter->second;
+
+        std::vector<std::uint32_t> fields;
+        std::unordered_set<GffLabel, GffLabel::Hash> replaced;
+
+        for (std::uint32_t i = 0; i < struc.field_count(); ++i)
+        {
+            GffFieldView field;
+            if (!struc.field(i, &field)) return fail(m_base.error());
+
+            if (edit)
+            {
+                GffLabel label(field.label());
+                if (edit->removed.count(label)) continue;
+
+                if (auto set = edit->set.GetFields().find(std::string(field.label())); set != std::end(edit->set.GetFields()))
+                {
+                    fields.push_back(m_out->add_friendly_field(edit->set, *set));
+                    replaced.insert(label);
+                    continue;
+                }
+            }
+
+            std::uint32_t index;
+            if (!copy_field(field, &index)) return false;
+            fields.push_back(index);
+        }
+
+        if (edit)
+        {
+            for (const FieldCodecs::SortedField& kvp : FieldCodecs::sorted_fields(edit->set))
+            {
+                if (replaced.count(kvp.label) || edit->removed.count(kvp.label)) continue;
+                fields.push_back(m_out->add_friendly_field(edit->set, *kvp.field));
+            }
+        }
+
+        m_out->set_struct_fields(*out, fields);
+        m_active[struc.index()] = false;
+        return true;
+    }
+
+    const char* error() const
+    {
+        return m_error;
+    }
+
+private:
+    bool fail(const char* message)
+    {
+        m_error = message;
+        return false;
+    }
+
+    // Carries a field over from the base without decoding it.
+    bool copy_field(const GffFieldView& field, std::uint32_t* out)
+    {
+        *out = m_out->reserve_field();
+        std::uint32_t data = field.raw_data();
+
+        if (field.type() == Raw::GffField::Type::Struct)
+        {
+            GffStructView child;
+            if (!field.read(&child) || !copy_struct(child, &data)) return fail(m_base.error());
+        }
+        else if (field.type() == Raw::GffField::Type::List)
+        {
+            GffListView list;
+            if (!field.read(&list)) return fail(m_base.error());
+
+            std::vector<std::uint32_t> structs(list.size());
+
+            for (std::uint32_t i = 0; i < list.size(); ++i)
+            {
+                GffStructView child;
+                if (!list.at(i, &child) || !copy_struct(child, &structs[i])) return fail(m_base.error());
+            }
+
+            data = m_out->add_list(structs);
+        }
+        else if (!is_simple_type(field.type()))
+        {
+            const std::byte* bytes;
+            std::size_t len;
+            if (!m_base.field_data(field, &bytes, &len)) return fail(m_base.error());
+            data = m_out->add_data(bytes, len);
+        }
+
+        m_out->set_field(*out, field.type(), field.label(), data);
+        return true;
+    }
+
+    const GffView& m_base;
+    const std::unordered_map<std::uint32_t, GffEdit::StructEdit>& m_edits;
+    GffBuilder* m_out;
+    std::vector<bool> m_active;
+    const char* m_error = "";
+};
+
+}
+
+bool GffEdit::write(std::vector<std::byte>* out) const
+{
+    GffBuilder builder;
+
+    if (!m_base)
+    {
+        // The top level struct's id is always 0xFFFFFFFF.
+        auto edit = m_edits.find(0);
+        std::uint32_t top = builder.add_struct(0xFFFFFFFF);
+        std::vector<std::uint32_t> fields;
+
+        if (edit != std::end(m_edits))
+        {
+            for (const FieldCodecs::SortedField& kvp : FieldCodecs::sorted_fields(edit->second.set))
+            {
+                if (edit->second.removed.count(kvp.label)) continue;
+                fields.push_back(builder.add_friendly_field(edit->second.set, *kvp.field));
+            }
+        }
+
+        builder.set_struct_fields(top, fields);
+    }
+    else
+    {
+        EditWriter writer(*m_base, m_edits, &builder);
+        GffStructView top;
+        std::uint32_t index;
+
+        if (!m_base->top_level(&top)) return fail(m_base->error());
+        if (!writer.copy_struct(top, &index)) return fail(writer.error());
+    }
+
+    builder.finish(m_file_type, out);
+    return true;
+}
+
+bool GffEdit::fail(const char* message) const
+{
+    m_error = message;
+    return false;
+}
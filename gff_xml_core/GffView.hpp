@@ -0,0 +1,186 @@
+#pragma once
+
+#include "GffLabel.hpp"
+#include "FileFormats/Gff.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Read-only view of binary GFF (V3.2) that decodes nothing up front. open() only checks the header; structs, lists
+// and fields are looked up in the raw tables as they are visited, so reading a handful of fields from a large .git
+// costs time in proportion to those fields rather than to the file. The bytes (usually a MappedFile) must outlive
+// the view and everything obtained from it.
+//
+// Every lookup is bounds-checked against the tables. Accessors return false on malformed data and leave a
+// description in GffView::error().
+
+class GffView;
+class GffListView;
+class GffStructView;
+
+class GffFieldView
+{
+public:
+    FileFormats::Gff::Raw::GffField::Type type() const { return m_type; }
+    std::string_view label() const { return m_label; }
+
+    // The data word of the field entry: the value itself for types of four bytes or less, otherwise an offset or
+    // index into the other tables.
+    std::uint32_t raw_data() const { return m_data; }
+
+    // Each of these fails if the field is of a different type.
+    bool read(FileFormats::Gff::Friendly::Type_BYTE* out) const;
+    bool read(FileFormats::Gff::Friendly::Type_CHAR* out) const;
+    bool read(FileFormats::Gff::Friendly::Type_WORD* out) const;
+    bool read(FileFormats::Gff::Friendly::Type_SHORT* out) const;
+    bool read(FileFormats::Gff::Friendly::Type_DWORD* out) const;
+    bool read(FileFormats::Gff::Friendly::Type_INT* out) const;
+    bool read(FileFormats::Gff::Friendly::Type_DWORD64* out) const;
+    bool read(FileFormats::Gff::Friendly::Type_INT64* out) const;
+    bool read(FileFormats::Gff::Friendly::Type_FLOAT* out) const;
+    bool read(FileFormats::Gff::Friendly::Type_DOUBLE* out) const;
+    bool read(FileFormats::Gff::Friendly::Type_CExoString* out) const;
+    bool read(FileFormats::Gff::Friendly::Type_CResRef* out) const;
+    bool read(FileFormats::Gff::Friendly::Type_CExoLocString* out) const;
+    bool read(FileFormats::Gff::Friendly::Type_VOID* out) const;
+    bool read(GffStructView* out) const;
+    bool read(GffListView* out) const;
+
+private:
+    friend class GffView;
+    friend class GffStructView;
+
+    template <typename T>
+    bool read_simple(FileFormats::Gff::Raw::GffField::Type type, T* out) const;
+
+    template <typename T>
+    bool read_complex(FileFormats::Gff::Raw::GffField::Type type, T* out) const;
+
+    const GffView* m_view = nullptr;
+    FileFormats::Gff::Raw::GffField::Type m_type = FileFormats::Gff::Raw::GffField::Type::BYTE;
+    std::string_view m_label;
+    std::uint32_t m_data = 0;
+};
+
+class GffStructView
+{
+public:
+    std::uint32_t index() const { return m_index; }
+    std::uint32_t id() const { return m_id; }
+    std::uint32_t field_count() const { return m_field_count; }
+
+    bool field(std::uint32_t i, GffFieldView* out) const;
+
+    // Linear in the number of fields in this struct. Returns false without setting an error if there is no such field.
+    bool find(std::string_view label, GffFieldView* out) const;
+
+private:
+    friend class GffView;
+
+    const GffView* m_view = nullptr;
+    std::uint32_t m_index = 0;
+    std::uint32_t m_id = 0;
+    std::uint32_t m_data = 0;
+    std::uint32_t m_field_count = 0;
+};
+
+class GffListView
+{
+public:
+    std::uint32_t size() const { return m_size; }
+    bool at(std::uint32_t i, GffStructView* out) const;
+
+private:
+    friend class GffFieldView;
+
+    const GffView* m_view = nullptr;
+    const std::byte* m_indices = nullptr;
+    std::uint32_t m_size = 0;
+};
+
+class GffView
+{
+public:
+    bool open(const std::byte* data, std::size_t len);
+
+    const char* file_type() const { return reinterpret_cast<const char*>(m_data); } // Four characters, not terminated.
+    std::uint32_t struct_count() const { return m_structs.count; }
+
+    bool top_level(GffStructView* out) const { return get_struct(0, out); }
+    bool get_struct(std::uint32_t index, GffStructView* out) const;
+
+    // The complete encoded value of a field stored in the field data table (everything but the simple types, Struct
+    // and List), including its length prefix. Lets a writer carry a value over without decoding it.
+    bool field_data(const GffFieldView& field, const std::byte** data, std::size_t* len) const;
+
+    const char* error() const { return m_error; }
+
+private:
+    friend class GffFieldView;
+    friend class GffListView;
+    friend class GffStructView;
+
+    struct Table
+    {
+        std::uint32_t offset;
+        std::uint32_t count; // Entries for structs, fields and labels; bytes for the rest.
+    };
+
+    bool fail(const char* message) const;
+    bool get_field(std::uint32_t index, GffFieldView* out) const;
+
+    // Bytes [offset, offset + len) of a table, or null (with an error set) if that runs off the end of it.
+    const std::byte* table_bytes(const Table& table, std::uint64_t offset, std::uint64_t len) const;
+
+    const std::byte* m_data = nullptr;
+    std::size_t m_len = 0;
+
+    Table m_structs {};
+    Table m_fields {};
+    Table m_labels {};
+    Table m_field_data {};
+    Table m_field_indices {};
+    Table m_list_indices {};
+
+    mutable const char* m_error = "";
+};
+
+// Copy-on-write edits over a GffView. Edits are kept as Friendly values keyed by the index of the struct they apply
+// to; write() then produces a new binary GFF in which every untouched field is carried over from the view byte for
+// byte, and only the edited fields are encoded afresh. Nothing in the base is decoded beyond walking its tables.
+class GffEdit
+{
+public:
+    // base may be null to build a document from scratch, starting from an empty top level struct.
+    GffEdit(const GffView* base);
+
+    void set_file_type(const char* type); // Four characters.
+
+    // Fields written here replace the same-labelled field of that struct in the base, in place, or are added after
+    // its existing fields. Struct 0 is the top level struct.
+    FileFormats::Gff::Friendly::GffStruct& edit_struct(std::uint32_t struct_index);
+    void remove_field(std::uint32_t struct_index, const char* label);
+
+    bool write(std::vector<std::byte>* out) const;
+
+    const char* error() const { return m_error; }
+
+    struct StructEdit
+    {
+        FileFormats::Gff::Friendly::GffStruct set;
+        std::unordered_set<GffLabel, GffLabel::Hash> removed; // Wins over anything set under the same label.
+    };
+
+private:
+    bool fail(const char* message) const;
+
+    const GffView* m_base;
+    char m_file_type[4];
+    std::unordered_map<std::uint32_t, StructEdit> m_edits;
+    mutable const char* m_error = "";
+};
@@ -1,202 +1,285 @@
 #include "GffXml.hpp"
+#include "ConvertLog.hpp"
+#include "FieldCodec.hpp"
+#include "GffBinary.hpp"
+#include "GffText.hpp"
+#include "MappedFile.hpp"
+#include "Profile.hpp"
+#include "XmlReader.hpp"
+#include "XmlWriter.hpp"
 #include "FileFormats/Gff.hpp"
-#include "tinyxml2.h"
 
 #include <algorithm>
+#include <any>
+#include <chrono>
 #include <cstdio>
+#include <cstring>
 #include <string>
+#include <string_view>
+#include <vector>
 
 using namespace FileFormats::Gff;
-using namespace tinyxml2;
+using namespace FieldCodecs;
+
+struct ConvertScratch::Buffers
+{
+    XmlReader xml_reader { nullptr, 0 };
+    std::vector<std::byte> encoded; // Binary output, which is only ever encoded whole.
+    std::vector<char> batch; // Text output on its way to the sink - see TimedSink.
+    SinkBuffers sink;
+};
+
+ConvertScratch::ConvertScratch()
+    : m_buffers(std::make_unique<Buffers>())
+{ }
+
+ConvertScratch::~ConvertScratch() = default;
 
 namespace {
 
-void write_to_xml_r(const Friendly::GffStruct& element, XMLDocument* doc, XMLElement* root, bool top_level = false, const char* element_name = nullptr);
-void read_from_xml_r(XMLElement* parent, Friendly::GffStruct* struc);
+struct XmlWriteContext
+{
+    XmlWriter& out;
+    const ConvertOptions& options;
+    ConvertReport* report;
+    std::size_t roundtrip_failures;
+    std::string read_back; // What the reader will make of the text just written; only used when verifying.
+};
+
+void write_to_xml_r(const Friendly::GffStruct& element, XmlWriteContext& ctx, bool top_level = false, const char* element_name = nullptr);
+bool read_struct(XmlReader& reader, Friendly::GffStruct* struc);
+bool read_from_xml_r(XmlReader& reader, Friendly::GffStruct* struc);
+
+ConvertScratch::Buffers& use_scratch(ConvertScratch* scratch, std::unique_ptr<ConvertScratch>* local)
+{
+    if (!scratch)
+    {
+        *local = std::make_unique<ConvertScratch>();
+        scratch = local->get();
+    }
+
+    return scratch->buffers();
+}
 
-bool read_from_xml(std::filesystem::path file, Friendly::Gff* out)
+bool decode_xml(const char* data, std::size_t len, Friendly::Gff* out, std::string* error, XmlReader& reader)
 {
-    XMLDocument doc;
-    if (doc.LoadFile(file.string().c_str()) != XML_SUCCESS) return false;
-    XMLElement* gff = doc.FirstChildElement("Gff");
-    char* file_type = out->GetFileType();
-    std::memcpy(file_type, gff->Attribute("Type"), 3);
-    file_type[3] = ' ';
-    read_from_xml_r(gff, &out->GetTopLevelStruct());
-    return true;
+    reader.reset(data, len);
+    bool success = false;
+    std::string_view type;
+
+    if (reader.next_element() != XmlReader::Token::StartElement || reader.name() != "Gff")
+    {
+        reader.fail("Expected a Gff root element.");
+    }
+    else if (!reader.attribute("Type", &type) || type.size() < 3)
+    {
+        reader.fail("Gff element is missing its Type attribute.");
+    }
+    else
+    {
+        char* file_type = out->GetFileType();
+        std::memcpy(file_type, type.data(), 3);
+        file_type[3] = ' ';
+        // Nothing but comments and whitespace may follow the root element.
+        success = read_struct(reader, &out->GetTopLevelStruct())
+            && reader.next() == XmlReader::Token::EndOfDocument;
+    }
+
+    if (!success)
+    {
+        *error = reader.error();
+    }
+
+    return success;
+}
+
+bool decode(const std::byte* data, std::size_t len, GffFormat format, Friendly::Gff* out, std::string* error,
+    ConvertScratch::Buffers& scratch)
+{
+    const char* chars = reinterpret_cast<const char*>(data);
+
+    switch (format)
+    {
+        case GffFormat::Xml: return decode_xml(chars, len, out, error, scratch.xml_reader);
+        case GffFormat::Text: return read_gff_text(chars, len, out, error);
+        case GffFormat::Binary: return read_gff_binary(data, len, out, error);
+    }
+
+    return false;
+}
+
+std::size_t encode_xml(const Friendly::Gff& in, XmlSink* sink, const ConvertOptions& options, ConvertReport* report)
+{
+    XmlWriter out(sink);
+    XmlWriteContext ctx { out, options, report, 0, {} };
+
+    out.open_element("Gff");
+    out.push_attribute("Version", 1);
+    out.push_attribute("Type", std::string(in.GetFileType(), 3).c_str());
+    write_to_xml_r(in.GetTopLevelStruct(), ctx, true);
+    out.close_element();
+
+    return ctx.roundtrip_failures;
 }
 
-bool read_from_gff(std::filesystem::path file, Friendly::Gff* out)
+// Writes in to sink in one of the text formats. Fails if any field failed round-trip verification.
+bool encode_text(const Friendly::Gff& in, GffFormat format, XmlSink* sink, const ConvertOptions& options,
+    ConvertReport* report)
 {
-    Raw::Gff gff_raw;
-    if (!Raw::Gff::ReadFromFile(file.string().c_str(), &gff_raw)) return false;
-    *out = Friendly::Gff(std::move(gff_raw));
+    std::size_t failures = format == GffFormat::Xml
+        ? encode_xml(in, sink, options, report)
+        : write_gff_text(in, sink, options, report);
+
+    if (failures)
+    {
+        log_msg(report, "%zu field(s) failed round-trip verification.\n", failures);
+
+        if (report)
+        {
+            report->failure = "Fields failed round-trip verification.";
+        }
+
+        return false;
+    }
+
     return true;
 }
 
-bool write_to_xml(std::filesystem::path file, const Friendly::Gff* in)
+// Replaces the contents of out with in, in the given format. Fails if any field failed round-trip verification.
+bool encode(const Friendly::Gff& in, GffFormat format, std::vector<std::byte>* out, const ConvertOptions& options,
+    ConvertReport* report)
 {
-    XMLDocument doc;
-    XMLElement* root = doc.NewElement("Gff");
-    root->SetAttribute("Version", 1);
-    root->SetAttribute("Type", std::string(in->GetFileType(), 3).c_str());
-    doc.InsertFirstChild(root);
-    write_to_xml_r(in->GetTopLevelStruct(), &doc, root, true);
-    return doc.SaveFile(file.string().c_str()) == XML_SUCCESS;
+    out->clear();
+
+    if (format == GffFormat::Binary)
+    {
+        out->resize(in.WriteToBytes(nullptr, 0));
+        return in.WriteToBytes(out->data(), out->size()) == out->size();
+    }
+
+    MemorySink sink(out);
+    return encode_text(in, format, &sink, options, report);
 }
 
-bool write_to_gff(std::filesystem::path file, const Friendly::Gff* in)
+bool finish_output(FileUpdateSink& sink, ConvertReport* report)
 {
-    return in->WriteToFile(file.string().c_str());
+    FileUpdateSink::Result result = sink.finish();
+
+    if (report)
+    {
+        report->written = result == FileUpdateSink::Result::Written;
+    }
+
+    return result != FileUpdateSink::Result::Failed;
 }
 
-template <typename T>
-XMLElement* create_generic_node(const char* type, const char* name, const T& value, XMLDocument* doc)
+void write_generic_node(const char* type, const char* name, const char* text, XmlWriter& out)
 {
-    XMLElement* new_node = doc->NewElement(type);
-    new_node->SetText(value);
-    new_node->SetAttribute("Name", name);
-    return new_node;
+    out.open_element(type);
+    out.push_attribute("Name", name);
+    out.push_text(text);
+    out.close_element();
 }
 
-void write_to_xml_r(const Friendly::GffStruct& element, XMLDocument* doc, XMLElement* root, bool top_level, const char* element_name)
+void write_to_xml_r(const Friendly::GffStruct& element, XmlWriteContext& ctx, bool top_level, const char* element_name)
 {
-    XMLElement* new_root = top_level ? nullptr : doc->NewElement("Struct");
+    XmlWriter& out = ctx.out;
 
-    if (new_root)
+    if (!top_level)
     {
+        out.open_element("Struct");
+
         if (element_name)
         {
-            new_root->SetAttribute("Name", element_name);
+            out.push_attribute("Name", element_name);
         }
 
-        new_root->SetAttribute("Id", element.GetUserDefinedId());
-        std::swap(root, new_root);
+        out.push_attribute("Id", element.GetUserDefinedId());
     }
 
-    for (auto const& kvp : element.GetFields())
+    FormatScratch scratch;
+
+    for (const FieldRef* field : sorted_fields(element))
     {
-        if (kvp.second.first == Raw::GffField::Type::BYTE)
-        {
-            Friendly::Type_BYTE value;
-            element.ReadField(kvp, &value);
-            root->InsertEndChild(create_generic_node("Byte", kvp.first.c_str(), value, doc));
-        }
-        else if (kvp.second.first == Raw::GffField::Type::CHAR)
-        {
-            Friendly::Type_CHAR value;
-            element.ReadField(kvp, &value);
-            root->InsertEndChild(create_generic_node("Char", kvp.first.c_str(), value, doc));
-        }
-        else if (kvp.second.first == Raw::GffField::Type::WORD)
-        {
-            Friendly::Type_WORD value;
-            element.ReadField(kvp, &value);
-            root->InsertEndChild(create_generic_node("Word", kvp.first.c_str(), value, doc));
-        }
-        else if (kvp.second.first == Raw::GffField::Type::SHORT)
-        {
-            Friendly::Type_SHORT value;
-            element.ReadField(kvp, &value);
-            root->InsertEndChild(create_generic_node("Short", kvp.first.c_str(), value, doc));
-        }
-        else if (kvp.second.first == Raw::GffField::Type::DWORD)
-        {
-            Friendly::Type_DWORD value;
-            element.ReadField(kvp, &value);
-            root->InsertEndChild(create_generic_node("DWord", kvp.first.c_str(), value, doc));
-        }
-        else if (kvp.second.first == Raw::GffField::Type::INT)
-        {
-            Friendly::Type_INT value;
-            element.ReadField(kvp, &value);
-            root->InsertEndChild(create_generic_node("Int", kvp.first.c_str(), value, doc));
-        }
-        else if (kvp.second.first == Raw::GffField::Type::DWORD64)
-        {
-            Friendly::Type_DWORD64 value;
-            element.ReadField(kvp, &value);
-            root->InsertEndChild(create_generic_node("DWord64", kvp.first.c_str(), value, doc));
-        }
-        else if (kvp.second.first == Raw::GffField::Type::INT64)
-        {
-            Friendly::Type_INT64 value;
-            element.ReadField(kvp, &value);
-            root->InsertEndChild(create_generic_node("Int64", kvp.first.c_str(), value, doc));
-        }
-        else if (kvp.second.first == Raw::GffField::Type::FLOAT)
-        {
-            Friendly::Type_FLOAT value;
-            element.ReadField(kvp, &value);
-            char flt[64];
-            std::sprintf(flt, "%f", value);
-            root->InsertEndChild(create_generic_node("Float", kvp.first.c_str(), flt, doc));
-        }
-        else if (kvp.second.first == Raw::GffField::Type::DOUBLE)
-        {
-            Friendly::Type_DOUBLE value;
-            element.ReadField(kvp, &value);
-            char dbl[64];
-            std::sprintf(dbl, "%f", value);
-            root->InsertEndChild(create_generic_node("Double", kvp.first.c_str(), dbl, doc));
-        }
-        else if (kvp.second.first == Raw::GffField::Type::CExoString)
-        {
-            Friendly::Type_CExoString value;
-            element.ReadField(kvp, &value);
-            root->InsertEndChild(create_generic_node("CExoString", kvp.first.c_str(), value.m_String.c_str(), doc));
-        }
-        else if (kvp.second.first == Raw::GffField::Type::ResRef)
+        const FieldRef& kvp = *field;
+        const FieldCodec& codec = codec_for(kvp.second.first);
+
+        if (codec.format)
         {
-            Friendly::Type_CResRef value;
-            element.ReadField(kvp, &value);
-            char resref[32];
-            std::sprintf(resref, "%.*s", value.m_Size, value.m_String);
-            root->InsertEndChild(create_generic_node("ResRef", kvp.first.c_str(), resref, doc));
+            const char* text = codec.format(element, kvp, &scratch);
+
+            if (ctx.options.verify_roundtrip)
+            {
+                // Checked against the text as it will be read, not as written, as XML loses line endings and
+                // whitespace-only strings.
+                XmlReader::read_back(text, &ctx.read_back);
+
+                if (!codec.verify(element, kvp, ctx.read_back.c_str()))
+                {
+                    log_msg(ctx.report, "%s %s does not round-trip: wrote '%s'.\n", codec.tag, kvp.first.c_str(), text);
+                    ++ctx.roundtrip_failures;
+                }
+            }
+
+            write_generic_node(codec.tag, kvp.first.c_str(), text, out);
         }
-        else if (kvp.second.first == Raw::GffField::Type::CExoLocString)
+        else if (codec.type == Raw::GffField::Type::CExoLocString)
         {
             Friendly::Type_CExoLocString value;
             element.ReadField(kvp, &value);
 
-            XMLElement* new_node = doc->NewElement("CExoLocString");
-            new_node->SetAttribute("Name", kvp.first.c_str());
-            new_node->InsertEndChild(create_generic_node("DWord", "StringRef", value.m_StringRef, doc));
+            out.open_element(codec.tag);
+            out.push_attribute("Name", kvp.first.c_str());
+            write_generic_node(codec_for(Raw::GffField::Type::DWORD).tag, "StringRef", format_value(value.m_StringRef, &scratch), out);
 
             for (std::size_t i = 0; i < value.m_SubStrings.size(); ++i)
             {
-                XMLElement* new_nod_substr = doc->NewElement("SubString");
-                new_nod_substr->InsertEndChild(create_generic_node("Int", "StringID", value.m_SubStrings[i].m_StringID, doc));
-                new_nod_substr->InsertEndChild(create_generic_node("CExoString", "String", value.m_SubStrings[i].m_String.c_str(), doc));
-                new_node->InsertEndChild(new_nod_substr);
+                const std::string& text = value.m_SubStrings[i].m_String;
+
+                if (ctx.options.verify_roundtrip)
+                {
+                    XmlReader::read_back(text.c_str(), &ctx.read_back);
+
+                    if (ctx.read_back != text)
+                    {
+                        log_msg(ctx.report, "%s %s substring %d does not round-trip: wrote '%s'.\n", codec.tag,
+                            kvp.first.c_str(), (int)value.m_SubStrings[i].m_StringID, text.c_str());
+                        ++ctx.roundtrip_failures;
+                    }
+                }
+
+                out.open_element("SubString");
+                write_generic_node(codec_for(Raw::GffField::Type::INT).tag, "StringID", format_value(value.m_SubStrings[i].m_StringID, &scratch), out);
+                write_generic_node(codec_for(Raw::GffField::Type::CExoString).tag, "String", text.c_str(), out);
+                out.close_element();
             }
 
-            root->InsertEndChild(new_node);
+            out.close_element();
         }
-        else if (kvp.second.first == Raw::GffField::Type::VOID)
+        else if (codec.type == Raw::GffField::Type::VOID)
         {
-            std::printf("VOID data detected in %s. Dropping.\n", kvp.first.c_str());
+            log_msg(ctx.report, "VOID data detected in %s. Dropping.\n", kvp.first.c_str());
         }
-        else if (kvp.second.first == Raw::GffField::Type::Struct)
+        else if (codec.type == Raw::GffField::Type::Struct)
         {
             Friendly::Type_Struct value;
             element.ReadField(kvp, &value);
-            write_to_xml_r(value, doc, root, false, kvp.first.c_str());
+            write_to_xml_r(value, ctx, false, kvp.first.c_str());
         }
-        else if (kvp.second.first == Raw::GffField::Type::List)
+        else if (codec.type == Raw::GffField::Type::List)
         {
             Friendly::Type_List value;
             element.ReadField(kvp, &value);
 
-            XMLElement* new_node = doc->NewElement("List");
-            new_node->SetAttribute("Name", kvp.first.c_str());
+            out.open_element(codec.tag);
+            out.push_attribute("Name", kvp.first.c_str());
 
             for (const Friendly::GffStruct& struc : value.GetStructs())
             {
-                write_to_xml_r(struc, doc, new_node);
+                write_to_xml_r(struc, ctx);
             }
 
-            root->InsertEndChild(new_node);
+            out.close_element();
         }
         else
         {
@@ -204,169 +287,365 @@ void write_to_xml_r(const Friendly::GffStruct& element, XMLDocument* doc, XMLEle
         }
     }
 
-    if (new_root)
+    if (!top_level)
     {
-        new_root->InsertEndChild(root);
+        out.close_element();
     }
 }
 
-void read_from_xml_r(XMLElement* parent, Friendly::GffStruct* struc)
+template <typename T>
+bool read_value(XmlReader& reader, T* out)
+{
+    std::string_view text;
+    if (!reader.read_text(&text)) return false;
+    return parse_value(text, out) || reader.fail("Malformed numeric value.");
+}
+
+bool read_struct(XmlReader& reader, Friendly::GffStruct* struc)
 {
-    XMLElement* element = parent->FirstChildElement();
+    std::string_view id_attr;
+    std::int64_t id = 0;
 
-    while (element)
+    if (reader.attribute("Id", &id_attr) && !parse_value(id_attr, &id))
     {
-        const char* name = element->Name();
+        return reader.fail("Malformed struct Id.");
+    }
 
-        if (std::strcmp(name, "Byte") == 0)
-        {
-            Friendly::Type_BYTE value = (Friendly::Type_BYTE)std::stoul(element->GetText());
-            struc->WriteField(element->FindAttribute("Name")->Value(), std::move(value));
-        }
-        else if (std::strcmp(name, "Char") == 0)
+    struc->SetUserDefinedId((std::uint32_t)id);
+    return read_from_xml_r(reader, struc);
+}
+
+bool read_cexolocstring(XmlReader& reader, Friendly::Type_CExoLocString* value)
+{
+    value->m_TotalSize = sizeof(value->m_StringRef) + sizeof(std::uint32_t); // string count
+    value->m_StringRef = 0;
+
+    XmlReader::Token token;
+
+    while ((token = reader.next_element()) == XmlReader::Token::StartElement)
+    {
+        if (reader.name() != "SubString")
         {
-            Friendly::Type_CHAR value = (Friendly::Type_CHAR)std::stoi(element->GetText());
-            struc->WriteField(element->FindAttribute("Name")->Value(), std::move(value));
+            if (!read_value(reader, &value->m_StringRef)) return false;
+            continue;
         }
-        else if (std::strcmp(name, "Word") == 0)
+
+        Friendly::Type_CExoLocString::SubString ss;
+        bool has_id = false;
+        bool has_string = false;
+
+        while ((token = reader.next_element()) == XmlReader::Token::StartElement)
         {
-            Friendly::Type_WORD value = (Friendly::Type_WORD)std::stoul(element->GetText());
-            struc->WriteField(element->FindAttribute("Name")->Value(), std::move(value));
+            const FieldCodec* codec = find_codec(reader.name());
+
+            if (codec && codec->type == Raw::GffField::Type::INT)
+            {
+                if (!read_value(reader, &ss.m_StringID)) return false;
+                has_id = true;
+            }
+            else if (codec && codec->type == Raw::GffField::Type::CExoString)
+            {
+                std::string_view text;
+                if (!reader.read_text(&text)) return false;
+                ss.m_String.assign(text);
+                has_string = true;
+            }
+            else if (!reader.skip_element())
+            {
+                return false;
+            }
         }
-        else if (std::strcmp(name, "Short") == 0)
+
+        if (token != XmlReader::Token::EndElement) return false;
+        if (!has_id || !has_string) return reader.fail("SubString is missing its Int or CExoString.");
+
+        value->m_TotalSize += sizeof(ss.m_StringID) + sizeof(std::uint32_t) + (std::uint32_t)ss.m_String.size();
+        value->m_SubStrings.emplace_back(std::move(ss));
+    }
+
+    return token == XmlReader::Token::EndElement;
+}
+
+bool read_from_xml_r(XmlReader& reader, Friendly::GffStruct* struc)
+{
+    // The reader sits just inside the element whose children are the fields of struc; stop at its end tag.
+
+    while (true)
+    {
+        XmlReader::Token token = reader.next_element();
+        if (token == XmlReader::Token::EndElement) return true;
+        if (token != XmlReader::Token::StartElement) return reader.fail("Unexpected end of document.");
+
+        const FieldCodec* codec = find_codec(reader.name());
+        if (!codec) return reader.fail("Unknown field type.");
+
+        // Labels are at most 16 characters. A longer one is rejected rather than cut short, as two labels sharing
+        // their first 16 characters would otherwise collapse into one field. A fixed buffer keeps them off the heap.
+        std::string_view label_attr;
+        if (!reader.attribute("Name", &label_attr)) return reader.fail("Field is missing its Name attribute.");
+        if (label_attr.size() > 16) return reader.fail("Field label is longer than 16 characters.");
+        char label[17] = {};
+        label_attr.copy(label, 16);
+
+        if (codec->parse)
         {
-            Friendly::Type_SHORT value = (Friendly::Type_SHORT)std::stoi(element->GetText());
-            struc->WriteField(element->FindAttribute("Name")->Value(), std::move(value));
+            std::string_view text;
+            if (!reader.read_text(&text)) return false;
+            if (!codec->parse(text, label, struc)) return reader.fail("Malformed field value.");
         }
-        else if (std::strcmp(name, "DWord") == 0)
+        else if (codec->type == Raw::GffField::Type::CExoLocString)
         {
-            Friendly::Type_DWORD value = std::stoul(element->GetText());
-            struc->WriteField(element->FindAttribute("Name")->Value(), std::move(value));
+            Friendly::Type_CExoLocString value;
+            if (!read_cexolocstring(reader, &value)) return false;
+            struc->WriteField(label, std::move(value));
         }
-        else if (std::strcmp(name, "Int") == 0)
+        else if (codec->type == Raw::GffField::Type::Struct)
         {
-            Friendly::Type_INT value = std::stoi(element->GetText());
-            struc->WriteField(element->FindAttribute("Name")->Value(), std::move(value));
+            Friendly::Type_Struct value;
+            if (!read_struct(reader, &value)) return false;
+            struc->WriteField(label, std::move(value));
         }
-        else if (std::strcmp(name, "DWord64") == 0)
+        else if (codec->type == Raw::GffField::Type::List)
         {
-            Friendly::Type_DWORD64 value = std::stoull(element->GetText());
-            struc->WriteField(element->FindAttribute("Name")->Value(), std::move(value));;
+            Friendly::Type_List value;
+
+            while ((token = reader.next_element()) == XmlReader::Token::StartElement)
+            {
+                // Built in place rather than assembled on the side and moved in.
+                if (!read_struct(reader, &value.GetStructs().emplace_back())) return false;
+            }
+
+            if (token != XmlReader::Token::EndElement) return false;
+            struc->WriteField(label, std::move(value));
         }
-        else if (std::strcmp(name, "Int64") == 0)
+        else
         {
-            Friendly::Type_INT64 value = std::stoll(element->GetText());
-            struc->WriteField(element->FindAttribute("Name")->Value(), std::move(value));
+            return reader.fail("Unknown field type.");
         }
-        else if (std::strcmp(name, "Float") == 0)
+    }
+}
+
+using Clock = std::chrono::steady_clock;
+
+// Seconds from start to now, moving start on to now for the next phase.
+double lap(Clock::time_point* start)
+{
+    Clock::time_point now = Clock::now();
+    double seconds = std::chrono::duration<double>(now - *start).count();
+    *start = now;
+    return seconds;
+}
+
+// Batches output on its way to another sink into blocks, timing how long that sink takes over each - so that a
+// conversion streamed straight to disk can still tell its writing apart from its serialising. Timing every one of
+// the writer's small writes would cost more than the writes themselves.
+class TimedSink : public XmlSink
+{
+public:
+    TimedSink(XmlSink* sink, std::vector<char>* buffer)
+        : m_sink(sink), m_buffer(*buffer)
+    {
+        m_buffer.clear();
+        m_buffer.reserve(block_size);
+    }
+
+    void write(const char* data, std::size_t len) override
+    {
+        if (m_buffer.size() + len > block_size)
         {
-            Friendly::Type_FLOAT value = std::stof(element->GetText());
-            struc->WriteField(element->FindAttribute("Name")->Value(), std::move(value));
+            flush();
         }
-        else if (std::strcmp(name, "Double") == 0)
+
+        if (len > block_size)
         {
-            Friendly::Type_DOUBLE value = std::stod(element->GetText());
-            struc->WriteField(element->FindAttribute("Name")->Value(), std::move(value));
+            pass_on(data, len);
         }
-        else if (std::strcmp(name, "CExoString") == 0)
+        else
         {
-            Friendly::Type_CExoString value;
-            value.m_String = element->GetText() ? element->GetText() : "";
-            struc->WriteField(element->FindAttribute("Name")->Value(), std::move(value));
+            m_buffer.insert(std::end(m_buffer), data, data + len);
         }
-        else if (std::strcmp(name, "ResRef") == 0)
-        {
-            Friendly::Type_CResRef value;
+    }
 
-            if (const char* text = element->GetText(); text)
-            {
-                value.m_Size = (uint8_t)std::strlen(text);
-                memcpy(value.m_String, text, value.m_Size);
-            }
-            else
-            {
-                value.m_Size = 0;
-            }
+    void flush()
+    {
+        pass_on(m_buffer.data(), m_buffer.size());
+        m_buffer.clear();
+    }
 
-            struc->WriteField(element->FindAttribute("Name")->Value(), std::move(value));
-        }
-        else if (std::strcmp(name, "CExoLocString") == 0)
-        {
-            Friendly::Type_CExoLocString value;
-            value.m_TotalSize = sizeof(value.m_StringRef) + sizeof(std::uint32_t); // string count
-            XMLElement* child = element->FirstChildElement();
+    std::uint64_t bytes() const { return m_bytes; }
+    double seconds() const { return std::chrono::duration<double>(m_time).count(); }
 
-            while (child)
-            {
-                if (std::strcmp(child->Name(), "SubString") == 0)
-                {
-                    Friendly::Type_CExoLocString::SubString ss;
-                    ss.m_StringID = std::stol(child->FirstChildElement("Int")->GetText());
-                    const char* str = child->FirstChildElement("CExoString")->GetText();
-                    ss.m_String = str ? str : "";
-                    value.m_TotalSize += sizeof(ss.m_StringID) + sizeof(std::uint32_t) + (std::uint32_t)ss.m_String.size();
-                    value.m_SubStrings.emplace_back(std::move(ss));
-                }
-                else
-                {
-                    value.m_StringRef = std::stoul(child->GetText());
-                }
+private:
+    static constexpr std::size_t block_size = 64 * 1024;
 
-                child = child->NextSiblingElement();
-            }
+    void pass_on(const char* data, std::size_t len)
+    {
+        if (!len) return;
 
-            struc->WriteField(element->FindAttribute("Name")->Value(), std::move(value));
-        }
-        else if (std::strcmp(name, "Struct") == 0)
+        Clock::time_point start = Clock::now();
+        m_sink->write(data, len);
+        m_time += Clock::now() - start;
+        m_bytes += len;
+    }
+
+    XmlSink* m_sink;
+    std::vector<char>& m_buffer;
+    Clock::duration m_time {};
+    std::uint64_t m_bytes = 0;
+};
+
+void count_nodes(const Friendly::GffStruct& struc, ConvertStats* stats)
+{
+    ++stats->structs;
+
+    for (const FieldRef& kvp : struc.GetFields())
+    {
+        ++stats->fields;
+
+        // Looked at in place - ReadField would copy the whole subtree.
+        if (const auto* child = std::any_cast<Friendly::Type_Struct>(&kvp.second.second))
         {
-            Friendly::Type_Struct value;
-            read_from_xml_r(element, &value);
-            struc->WriteField(element->FindAttribute("Name")->Value(), std::move(value));
+            count_nodes(*child, stats);
         }
-        else if (std::strcmp(name, "List") == 0)
+        else if (const auto* list = std::any_cast<Friendly::Type_List>(&kvp.second.second))
         {
-            Friendly::Type_List value;
-            XMLElement* child = element->FirstChildElement();
+            ++stats->lists;
 
-            while (child)
+            for (const Friendly::GffStruct& element : list->GetStructs())
             {
-                Friendly::GffStruct child_struc;
-                read_from_xml_r(child, &child_struc);
-                value.GetStructs().emplace_back(std::move(child_struc));
-                child = child->NextSiblingElement();
+                count_nodes(element, stats);
             }
+        }
+    }
+}
 
-            struc->WriteField(element->FindAttribute("Name")->Value(), std::move(value));
+// Hands a conversion's phase times and counts to the profiler, if it is running.
+void profile_stats(const ConvertStats& stats)
+{
+    PROFILE_TIME(ProfilePhase::Load, stats.read);
+    PROFILE_TIME(ProfilePhase::Parse, stats.parse);
+    PROFILE_TIME(ProfilePhase::Encode, stats.serialize);
+    PROFILE_TIME(ProfilePhase::Write, stats.write);
+    PROFILE_COUNT(ProfileCounter::Structs, stats.structs);
+    PROFILE_COUNT(ProfileCounter::Fields, stats.fields);
+    PROFILE_COUNT(ProfileCounter::Lists, stats.lists);
+    PROFILE_COUNT(ProfileCounter::BytesIn, stats.bytes_in);
+    PROFILE_COUNT(ProfileCounter::BytesOut, stats.bytes_out);
+}
 
-        }
-        else
-        {
-            ASSERT_FAIL();
-        }
+// Logs message and keeps it as the reason the conversion failed.
+void fail_msg(ConvertReport* report, const char* message)
+{
+    log_msg(report, "%s\n", message);
+
+    if (report && report->failure.empty())
+    {
+        report->failure = message;
+    }
+}
+
+}
+
+GffFormat gff_format_for(const std::filesystem::path& path)
+{
+    std::filesystem::path ext = path.extension();
+    if (ext == ".xml") return GffFormat::Xml;
+    if (ext == ".gfft") return GffFormat::Text;
+    return GffFormat::Binary;
+}
+
+bool read_gff(const std::byte* data, std::size_t len, GffFormat format, Friendly::Gff* out, std::string* log, ConvertScratch* scratch)
+{
+    std::unique_ptr<ConvertScratch> local_scratch;
+    std::string error;
+
+    if (decode(data, len, format, out, &error, use_scratch(scratch, &local_scratch))) return true;
+
+    if (log)
+    {
+        *log += error;
+        *log += "\n";
+    }
+
+    return false;
+}
 
-        element = element->NextSiblingElement();
+bool write_gff(const Friendly::Gff& gff, GffFormat format, std::vector<std::byte>* out, const ConvertOptions& options,
+    std::string* log)
+{
+    ConvertReport report;
+    bool success = encode(gff, format, out, options, &report);
+
+    if (log)
+    {
+        *log += report.log;
     }
 
-    struc->SetUserDefinedId(parent->IntAttribute("Id"));
+    return success;
 }
 
+bool convert_gff(const std::byte* data, std::size_t len, GffFormat from, GffFormat to, std::vector<std::byte>* out,
+    const ConvertOptions& options, std::string* log, ConvertScratch* scratch)
+{
+    std::unique_ptr<ConvertScratch> local_scratch;
+    scratch = scratch ? scratch : (local_scratch = std::make_unique<ConvertScratch>()).get();
+
+    Friendly::Gff gff;
+    return read_gff(data, len, from, &gff, log, scratch) && write_gff(gff, to, out, options, log);
 }
 
-bool convert_file(std::filesystem::path path_in, std::filesystem::path path_out)
+bool convert_file(std::filesystem::path path_in, std::filesystem::path path_out, const ConvertOptions& options, ConvertReport* report,
+    ConvertScratch* scratch)
 {
-    bool read_xml = path_in.extension() == ".xml";
-    bool write_xml = path_out.extension() == ".xml";
+    std::unique_ptr<ConvertScratch> local_scratch;
+    ConvertScratch::Buffers& buffers = use_scratch(scratch, &local_scratch);
 
-    std::printf("Processing %s -> %s.\n", path_in.string().c_str(), path_out.string().c_str());
+    ConvertStats stats;
+    Clock::time_point start = Clock::now();
+
+    log_msg(report, "Processing %s -> %s.\n", path_in.string().c_str(), path_out.string().c_str());
 
     Friendly::Gff gff;
+    MappedFile data;
+    std::string error;
+
+    bool read_success = data.open(path_in);
+    stats.bytes_in = data.size();
+    stats.read = lap(&start);
 
-    if (bool read_success = read_xml ? read_from_xml(path_in, &gff) : read_from_gff(path_in, &gff); !read_success)
+    read_success = read_success && decode(data.data(), data.size(), gff_format_for(path_in), &gff, &error, buffers);
+    stats.parse = lap(&start);
+
+    if (!read_success)
     {
-        std::printf("Failed to read.\n");
+        if (!error.empty())
+        {
+            log_msg(report, "%s: %s\n", path_in.string().c_str(), error.c_str());
+
+            if (report)
+            {
+                report->failure = error;
+            }
+        }
+
+        fail_msg(report, "Failed to read.");
+        profile_stats(stats);
+
+        if (report)
+        {
+            report->stats = stats;
+        }
+
         return false;
     }
 
+    data.close();
+
+    if ((report && options.count_nodes) || profile_enabled())
+    {
+        count_nodes(gff.GetTopLevelStruct(), &stats);
+    }
+
     if (path_out.extension() == ".?")
     {
         std::string new_ext = std::string(gff.GetFileType(), 3);
@@ -374,9 +653,62 @@ bool convert_file(std::filesystem::path path_in, std::filesystem::path path_out)
         path_out.replace_extension(std::move(new_ext));
     }
 
-    if (bool write_success = write_xml ? write_to_xml(path_out, &gff) : write_to_gff(path_out, &gff); !write_success)
+    if (report)
+    {
+        report->path_out = path_out;
+    }
+
+    GffFormat format = gff_format_for(path_out);
+    FileUpdateSink sink(path_out, format != GffFormat::Binary, &buffers.sink);
+    bool success;
+    start = Clock::now();
+
+    if (format == GffFormat::Binary)
+    {
+        // The library only encodes binary GFF whole. The buffer lives in the scratch, so this costs no allocation
+        // once a thread has seen its largest file.
+        success = encode(gff, format, &buffers.encoded, options, report);
+        stats.bytes_out = buffers.encoded.size();
+        stats.serialize = lap(&start);
+
+        if (success)
+        {
+            sink.write(reinterpret_cast<const char*>(buffers.encoded.data()), buffers.encoded.size());
+            success = finish_output(sink, report);
+        }
+
+        stats.write = lap(&start);
+    }
+    else
+    {
+        // Text is streamed into the sink as it's formatted, so memory stays bounded by the nesting depth however
+        // large the file. The time the sink takes is what counts as writing; the rest is serialising. On failure the
+        // sink is never finished, which leaves the existing file as it was.
+        TimedSink timed(&sink, &buffers.batch);
+        success = encode_text(gff, format, &timed, options, report);
+        timed.flush();
+
+        if (success)
+        {
+            Clock::time_point finish_start = Clock::now();
+            success = finish_output(sink, report);
+            stats.write = std::chrono::duration<double>(Clock::now() - finish_start).count();
+        }
+
+        stats.bytes_out = timed.bytes();
+        stats.write += timed.seconds();
+        stats.serialize = lap(&start) - stats.write;
+    }
+    profile_stats(stats);
+
+    if (report)
+    {
+        report->stats = stats;
+    }
+
+    if (!success)
     {
-        std::printf("Failed to write.\n");
+        fail_msg(report, "Failed to write.");
         return false;
     }
 
@@ -1,3 +1,96 @@
+#pragma once
+
+#include "FileFormats/Gff.hpp"
+
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Bump whenever a change alters the bytes convert_file produces for the same input, so that anything caching
+// conversion results (see gff_xml_packer) knows to throw them away.
+constexpr std::uint32_t gff_xml_output_version = 2;
+
+struct ConvertOptions
+{
+    // Re-parse every value as it is written to XML or GFF text, as the reader will see it, and report any field that
+    // doesn't reproduce the original bits. Any mismatch fails the conversion. Writing binary GFF checks nothing.
+    bool verify_roundtrip = false;
+
+    // Fill in the struct, field and list counts of ConvertStats, which takes an extra walk over the tree.
+    bool count_nodes = false;
+};
+
+// What convert_file did with a file. Times are wall-clock seconds per phase: read maps the input, parse decodes it,
+// serialize encodes the output in memory and write compares it against the existing file and replaces that if need be.
+struct ConvertStats
+{
+    std::uint64_t bytes_in = 0;
+    std::uint64_t bytes_out = 0;
+    std::uint64_t structs = 0;
+    std::uint64_t fields = 0;
+    std::uint64_t lists = 0;
+    double read = 0.0;
+    double parse = 0.0;
+    double serialize = 0.0;
+    double write = 0.0;
+};
+
+// Optional out-parameter for convert_file. When provided, anything the conversion would have printed is appended to
+// log instead, so batch callers running several conversions at once can emit each file's output in one piece.
+struct ConvertReport
+{
+    std::string log;
+    std::filesystem::path path_out; // Where the output actually went, after resolving a ".?" extension.
+    bool written = false; // False if the destination already held identical content and was left untouched.
+    std::string failure; // Why the conversion failed, in a line.
+    ConvertStats stats;
+};
+
+// Working memory for convert_file: the XML parser's stacks and decode buffers, the buffers output passes through
+// on its way out and the blocks used to compare it against the existing file. Without one, every conversion allocates and
+// frees all of these; a batch caller keeps one per thread and hands it to each conversion that thread runs, so the
+// same memory serves file after file and is released in one go when the scratch is destroyed.
+class ConvertScratch
+{
+public:
+    ConvertScratch();
+    ~ConvertScratch();
+
+    struct Buffers;
+    Buffers& buffers() { return *m_buffers; }
+
+private:
+    std::unique_ptr<Buffers> m_buffers;
+};
+
+enum class GffFormat
+{
+    Binary,
+    Xml,
+    Text // .gfft
+};
+
+// By extension: .xml and .gfft are text, anything else is binary GFF.
+GffFormat gff_format_for(const std::filesystem::path& path);
+
+// In-memory conversion, for callers that have the bytes already or want them back rather than on disk. None of these
+// print anything: what convert_file would have printed is appended to log if given, and dropped otherwise. Where
+// there is a scratch, it is optional, as for convert_file; encoding writes straight into out, so needs none.
+
+bool read_gff(const std::byte* data, std::size_t len, GffFormat format, FileFormats::Gff::Friendly::Gff* out,
+    std::string* log = nullptr, ConvertScratch* scratch = nullptr);
+
+// Replaces the contents of out.
+bool write_gff(const FileFormats::Gff::Friendly::Gff& gff, GffFormat format, std::vector<std::byte>* out,
+    const ConvertOptions& options = {}, std::string* log = nullptr);
+
+bool convert_gff(const std::byte* data, std::size_t len, GffFormat from, GffFormat to, std::vector<std::byte>* out,
+    const ConvertOptions& options = {}, std::string* log = nullptr, ConvertScratch* scratch = nullptr);
 
-bool convert_file(std::filesystem::path path_in, std::filesystem::path path_out);
+// Maps path_in, converts it to the format implied by path_out's extension and writes it there if it changed. A ".?"
+// extension on path_out is replaced with the lowercased GFF file type.
+bool convert_file(std::filesystem::path path_in, std::filesystem::path path_out,
+    const ConvertOptions& options = {}, ConvertReport* report = nullptr, ConvertScratch* scratch = nullptr);
@@ -0,0 +1,117 @@
+#include "MappedFile.hpp"
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const std::filesystem::path& path)
+{
+    close();
+
+    HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    m_file = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) return false;
+    if (size.QuadPart == 0) return true;
+
+    m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping) return false;
+
+    m_data = static_cast<const std::byte*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data) return false;
+
+    m_size = (std::size_t)size.QuadPart;
+    return true;
+}
+
+void prefetch_file(const std::filesystem::path&)
+{
+}
+
+void MappedFile::close()
+{
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_mapping) CloseHandle(m_mapping);
+    if (m_file) CloseHandle(m_file);
+
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+    m_file = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::filesystem::path& path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) return false;
+
+    struct stat info;
+    bool success = ::fstat(fd, &info) == 0;
+
+    if (success && info.st_size > 0)
+    {
+        void* data = ::mmap(nullptr, (std::size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        success = data != MAP_FAILED;
+
+        if (success)
+        {
+            // Everything we map is read front to back.
+            ::madvise(data, (std::size_t)info.st_size, MADV_SEQUENTIAL);
+            m_data = static_cast<const std::byte*>(data);
+            m_size = (std::size_t)info.st_size;
+        }
+    }
+
+    // The mapping keeps its own reference to the file.
+    ::close(fd);
+    return success;
+}
+
+void prefetch_file(const std::filesystem::path& path)
+{
+#if defined(POSIX_FADV_WILLNEED)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) return;
+
+    // Starts readahead of the whole file and returns without waiting for it. The pages stay cached after the close.
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    ::close(fd);
+#else
+    (void)path;
+#endif
+}
+
+void MappedFile::close()
+{
+    if (m_data)
+    {
+        ::munmap(const_cast<std::byte*>(m_data), m_size);
+    }
+
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
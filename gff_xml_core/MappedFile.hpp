@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+// Read-only view of a whole file, mapped into memory rather than copied. Pages are only read from disk as they are
+// touched and belong to the page cache, so the view costs no heap and large inputs don't double up in memory.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps path, replacing any previous mapping. An empty file maps successfully with size() == 0.
+    bool open(const std::filesystem::path& path);
+    void close();
+
+    const std::byte* data() const { return m_data; }
+    const char* chars() const { return reinterpret_cast<const char*>(m_data); }
+    std::size_t size() const { return m_size; }
+
+private:
+    const std::byte* m_data = nullptr;
+    std::size_t m_size = 0;
+
+#if defined(_WIN32)
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
+
+// Asks the OS to start reading path into the page cache in the background, so that a later read, mapping or kernel
+// copy of it finds the data already there. Only a hint: it does nothing where unsupported, and never fails.
+void prefetch_file(const std::filesystem::path& path);
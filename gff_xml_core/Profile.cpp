@@ -0,0 +1,74 @@
+#include "Profile.hpp"
+
+#if defined(ANPH_PROFILING)
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+
+namespace {
+
+constexpr std::size_t phase_count = (std::size_t)ProfilePhase::Count;
+constexpr std::size_t counter_count = (std::size_t)ProfileCounter::Count;
+
+const char* const phase_names[phase_count] = { "load", "parse", "build", "encode", "write" };
+const char* const counter_names[counter_count] = { "structs", "fields", "lists", "entries", "bytes in", "bytes out" };
+
+std::atomic<bool> g_enabled { false };
+std::atomic<std::uint64_t> g_phase_ns[phase_count];
+std::atomic<std::uint64_t> g_counters[counter_count];
+
+}
+
+bool profile_enable()
+{
+    g_enabled.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+bool profile_enabled()
+{
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+void profile_add_time(ProfilePhase phase, double seconds)
+{
+    g_phase_ns[(std::size_t)phase].fetch_add((std::uint64_t)(seconds * 1e9), std::memory_order_relaxed);
+}
+
+void profile_add(ProfileCounter counter, std::uint64_t count)
+{
+    g_counters[(std::size_t)counter].fetch_add(count, std::memory_order_relaxed);
+}
+
+void profile_print()
+{
+    if (!profile_enabled()) return;
+
+    std::uint64_t total_ns = 0;
+
+    for (const std::atomic<std::uint64_t>& ns : g_phase_ns)
+    {
+        total_ns += ns.load(std::memory_order_relaxed);
+    }
+
+    std::printf("Profile:\n");
+
+    for (std::size_t i = 0; i < phase_count; ++i)
+    {
+        std::uint64_t ns = g_phase_ns[i].load(std::memory_order_relaxed);
+        if (!ns) continue;
+        std::printf("  %-10s %12.3f ms %6.1f%%\n", phase_names[i], ns / 1e6, total_ns ? 100.0 * ns / total_ns : 0.0);
+    }
+
+    std::printf("  %-10s %12.3f ms\n", "total", total_ns / 1e6);
+
+    for (std::size_t i = 0; i < counter_count; ++i)
+    {
+        std::uint64_t count = g_counters[i].load(std::memory_order_relaxed);
+        if (!count) continue;
+        std::printf("  %-10s %12" PRIu64 "\n", counter_names[i], count);
+    }
+}
+
+#endif
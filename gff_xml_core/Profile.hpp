@@ -0,0 +1,86 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Phase timers and counters for seeing where conversion time goes, shared by gff_xml and tlk_xml behind their
+// --profile flag. All of it compiles away unless the build defines ANPH_PROFILING (the CMake option of the same
+// name); compiled in, nothing is recorded until profile_enable() is called, and each probe costs one branch.
+// Totals are kept across threads and conversions until profile_print().
+
+enum class ProfilePhase
+{
+    Load, // Getting the input into memory.
+    Parse, // Parsing it. The streaming readers build the tree as they go, so for them this includes Build.
+    Build, // Turning a parsed document into the in-memory tree.
+    Encode, // Producing the output in memory.
+    Write, // Getting the output onto disk. Streaming writers encode as they go, so for them this includes Encode.
+    Count
+};
+
+enum class ProfileCounter
+{
+    Structs,
+    Fields,
+    Lists,
+    Entries, // TLK.
+    BytesIn,
+    BytesOut,
+    Count
+};
+
+#if defined(ANPH_PROFILING)
+
+bool profile_enable(); // Returns false if profiling was compiled out.
+bool profile_enabled();
+void profile_add_time(ProfilePhase phase, double seconds);
+void profile_add(ProfileCounter counter, std::uint64_t count);
+void profile_print();
+
+class ProfileScope
+{
+public:
+    ProfileScope(ProfilePhase phase)
+        : m_phase(phase), m_active(profile_enabled())
+    {
+        if (m_active)
+        {
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ProfileScope()
+    {
+        if (m_active)
+        {
+            profile_add_time(m_phase, std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count());
+        }
+    }
+
+private:
+    ProfilePhase m_phase;
+    bool m_active;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+// Times the rest of the enclosing scope.
+#define PROFILE_SCOPE(phase) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(phase)
+
+// For phases the caller has timed already. Arguments are only evaluated while profiling.
+#define PROFILE_TIME(phase, seconds) (profile_enabled() ? profile_add_time(phase, seconds) : (void)0)
+#define PROFILE_COUNT(counter, count) (profile_enabled() ? profile_add(counter, count) : (void)0)
+
+#else
+
+inline bool profile_enable() { return false; }
+inline bool profile_enabled() { return false; }
+inline void profile_print() { }
+
+#define PROFILE_SCOPE(phase) ((void)0)
+#define PROFILE_TIME(phase, seconds) ((void)sizeof(seconds))
+#define PROFILE_COUNT(counter, count) ((void)sizeof(count))
+
+#endif
@@ -0,0 +1,139 @@
+#include "TlkBinary.hpp"
+#include "ContentHash.hpp"
+#include "TlkView.hpp"
+
+#include <cstring>
+#include <limits>
+
+using namespace FileFormats::Tlk;
+using namespace TlkFormat;
+
+namespace {
+
+void write_u32(std::byte* pos, std::uint32_t value)
+{
+    std::memcpy(pos, &value, sizeof(value));
+}
+
+bool fail(std::string* error, const char* message)
+{
+    *error = message;
+    return false;
+}
+
+}
+
+std::size_t TlkStringTable::Hash::operator()(std::string_view text) const
+{
+    return (std::size_t)hash_bytes(text.data(), text.size());
+}
+
+std::uint32_t TlkStringTable::add(std::string_view text)
+{
+    ++m_stats.strings;
+
+    // An empty string takes no space wherever it points.
+    if (text.empty()) return 0;
+
+    auto [iter, added] = m_offsets.try_emplace(text, (std::uint32_t)m_stats.bytes);
+
+    if (added)
+    {
+        m_strings.push_back(text);
+        m_stats.bytes += text.size();
+    }
+    else
+    {
+        ++m_stats.shared;
+        m_stats.bytes_saved += text.size();
+    }
+
+    return iter->second;
+}
+
+void TlkStringTable::copy_to(std::byte* out) const
+{
+    for (std::string_view text : m_strings)
+    {
+        std::memcpy(out, text.data(), text.size());
+        out += text.size();
+    }
+}
+
+void encode_tlk_entry(const Friendly::TlkEntry& entry, std::uint32_t string_offset, std::byte* out)
+{
+    std::uint32_t flags = 0;
+
+    if (entry.m_String)
+    {
+        flags |= text_present;
+        write_u32(out + string_offset_offset, string_offset);
+        write_u32(out + string_size_offset, (std::uint32_t)entry.m_String->size());
+    }
+
+    if (entry.m_SoundResRef)
+    {
+        flags |= sound_present;
+        std::memcpy(out + resref_offset, entry.m_SoundResRef->data(), entry.m_SoundResRef->size());
+    }
+
+    if (entry.m_SoundLength)
+    {
+        flags |= sound_length_present;
+        std::memcpy(out + sound_length_offset, &*entry.m_SoundLength, sizeof(float));
+    }
+
+    write_u32(out, flags);
+}
+
+bool write_tlk_binary(const Friendly::Tlk& tlk, std::vector<std::byte>* out, std::string* error, TlkStringStats* stats)
+{
+    std::uint64_t count = 0;
+    TlkStringTable strings;
+    std::vector<std::uint32_t> string_offsets; // For each entry with a string, in StrRef order.
+
+    for (const auto& [strref, entry] : tlk)
+    {
+        if (entry.m_SoundResRef && entry.m_SoundResRef->size() > resref_size)
+        {
+            return fail(error, "SoundResRef is longer than 16 characters.");
+        }
+
+        count = strref + 1ull;
+
+        if (entry.m_String)
+        {
+            string_offsets.push_back(strings.add(*entry.m_String));
+        }
+    }
+
+    if (count > max_entries) return fail(error, "StrRef is out of range for a talk table.");
+    if (strings.size() > std::numeric_limits<std::uint32_t>::max()) return fail(error, "TLK string data would exceed 4 GB.");
+
+    std::size_t entries_size = (std::size_t)count * entry_size;
+    out->assign(header_size + entries_size + strings.size(), std::byte { 0 });
+
+    std::byte* header = out->data();
+    std::byte* entries = header + header_size;
+
+    std::memcpy(header, "TLK V3.0", 8);
+    write_u32(header + 8, tlk.GetLanguageId());
+    write_u32(header + 12, (std::uint32_t)count);
+    write_u32(header + 16, (std::uint32_t)(header_size + entries_size));
+
+    auto string_offset = std::begin(string_offsets);
+
+    for (const auto& [strref, entry] : tlk)
+    {
+        encode_tlk_entry(entry, entry.m_String ? *string_offset++ : 0, entries + (std::size_t)strref * entry_size);
+    }
+
+    strings.copy_to(entries + entries_size);
+
+    if (stats)
+    {
+        *stats = strings.stats();
+    }
+
+    return true;
+}
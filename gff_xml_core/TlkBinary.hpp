@@ -0,0 +1,55 @@
+#pragma once
+
+#include "FileFormats/Tlk.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// How much string data sharing saved in a written table.
+struct TlkStringStats
+{
+    std::size_t strings = 0; // Entries with a string.
+    std::size_t shared = 0; // Of those, the ones pointing at a copy stored for another entry.
+    std::uint64_t bytes = 0; // String data as stored.
+    std::uint64_t bytes_saved = 0; // String data that would have been stored for the shared ones.
+};
+
+// Lays out the string data of a talk table, storing each distinct string once. Entries address their string by
+// offset and size alone, so any number of them can point at the same bytes without readers being any the wiser.
+// Added strings are referred to, not copied, and must outlive the table.
+class TlkStringTable
+{
+public:
+    // The offset of text in the string data, which is where an identical string went if there was one.
+    std::uint32_t add(std::string_view text);
+
+    std::uint64_t size() const { return m_stats.bytes; }
+
+    // Copies the string data, size() bytes of it, to out.
+    void copy_to(std::byte* out) const;
+
+    const TlkStringStats& stats() const { return m_stats; }
+
+private:
+    struct Hash
+    {
+        std::size_t operator()(std::string_view text) const;
+    };
+
+    std::unordered_map<std::string_view, std::uint32_t, Hash> m_offsets;
+    std::vector<std::string_view> m_strings; // Distinct, in layout order.
+    TlkStringStats m_stats;
+};
+
+// Encodes entry into the entry_size bytes at out, which must be zeroed, pointing it at string_offset for its string.
+// Variances are left at zero, as nothing in Friendly::TlkEntry carries them.
+void encode_tlk_entry(const FileFormats::Tlk::Friendly::TlkEntry& entry, std::uint32_t string_offset, std::byte* out);
+
+// Encodes tlk as a binary talk table (V3.0), with identical strings stored once. On failure, error describes what
+// was wrong.
+bool write_tlk_binary(const FileFormats::Tlk::Friendly::Tlk& tlk, std::vector<std::byte>* out, std::string* error,
+    TlkStringStats* stats = nullptr);
@@ -0,0 +1,199 @@
+#include "TlkPatch.hpp"
+#include "Profile.hpp"
+#include "TlkBinary.hpp"
+#include "TlkView.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using namespace FileFormats::Tlk;
+using namespace TlkFormat;
+
+namespace {
+
+std::uint32_t read_u32(const std::byte* pos)
+{
+    std::uint32_t value;
+    std::memcpy(&value, pos, sizeof(value));
+    return value;
+}
+
+void write_u32(std::byte* pos, std::uint32_t value)
+{
+    std::memcpy(pos, &value, sizeof(value));
+}
+
+bool fail(std::string* error, const char* message)
+{
+    *error = message;
+    return false;
+}
+
+// Contiguous string data carried over from the base: the strings of one or more untouched entries that sit next to
+// or overlap each other there, and so are copied as one.
+struct Run
+{
+    std::uint64_t base_offset;
+    std::uint64_t base_end;
+    std::uint64_t offset; // In the new string data.
+};
+
+}
+
+bool apply_tlk_patch(const std::byte* base, std::size_t len, const TlkPatch& patch, std::vector<std::byte>* out,
+    std::string* error)
+{
+    TlkView view;
+    if (!view.open(base, len)) return fail(error, view.error());
+
+    std::uint32_t base_count = view.size();
+    std::uint64_t patched_end = 0; // One past the last entry the patch adds.
+    TlkStringTable added; // Strings of patched entries, which go after the ones copied over.
+    std::vector<std::uint32_t> added_offsets; // For each patched entry with a string, in StrRef order.
+
+    for (const auto& [strref, entry] : patch.entries)
+    {
+        if (!entry) continue;
+        if (entry->m_SoundResRef && entry->m_SoundResRef->size() > resref_size)
+        {
+            return fail(error, "SoundResRef is longer than 16 characters.");
+        }
+
+        patched_end = std::max<std::uint64_t>(patched_end, strref + 1ull);
+
+        if (entry->m_String)
+        {
+            added_offsets.push_back(added.add(*entry->m_String));
+        }
+    }
+
+    std::uint64_t count = std::max<std::uint64_t>(base_count, patched_end);
+
+    if (patch.entry_count)
+    {
+        if (patched_end > *patch.entry_count) return fail(error, "Patched entry lies past the end of the table.");
+        count = *patch.entry_count;
+    }
+    else
+    {
+        // Deleting the last entries shrinks the table rather than leaving empty entries at its end.
+        for (auto it = patch.entries.rbegin(); it != patch.entries.rend() && !it->second; ++it)
+        {
+            if (it->first + 1ull == count) --count;
+        }
+    }
+
+    if (count > max_entries) return fail(error, "StrRef is out of range for a talk table.");
+
+    const std::byte* base_strings = view.string_data();
+    std::uint64_t base_strings_size = view.string_data_size();
+    std::uint32_t kept_count = (std::uint32_t)std::min<std::uint64_t>(base_count, count);
+
+    // Untouched entries with string data, walking the patch alongside so as not to look every entry up in it.
+    std::vector<std::uint32_t> kept;
+    auto patched = patch.entries.begin();
+
+    for (std::uint32_t i = 0; i < kept_count; ++i)
+    {
+        while (patched != patch.entries.end() && patched->first < i) ++patched;
+        if (patched != patch.entries.end() && patched->first == i) continue;
+
+        const std::byte* entry = view.entry_data(i);
+        std::uint64_t size = read_u32(entry + string_size_offset);
+        if (size == 0) continue;
+
+        if (read_u32(entry + string_offset_offset) + size > base_strings_size)
+        {
+            return fail(error, "TLK string extends past the end of the file.");
+        }
+
+        kept.push_back(i);
+    }
+
+    // Taking the kept strings in the order they are laid out in the base, neighbouring strings merge into runs. Tables
+    // normally store their strings in StrRef order, so this is one run broken only where the patch made a gap.
+    auto string_offset = [&](std::uint32_t i)
+    {
+        return read_u32(view.entry_data(i) + string_offset_offset);
+    };
+
+    std::sort(std::begin(kept), std::end(kept), [&](std::uint32_t lhs, std::uint32_t rhs)
+    {
+        return string_offset(lhs) < string_offset(rhs);
+    });
+
+    std::vector<Run> runs;
+    std::vector<std::uint32_t> kept_offsets(kept_count, 0);
+
+    for (std::uint32_t i : kept)
+    {
+        std::uint64_t offset = string_offset(i);
+        std::uint64_t end = offset + read_u32(view.entry_data(i) + string_size_offset);
+
+        if (runs.empty() || offset > runs.back().base_end)
+        {
+            std::uint64_t run_offset = runs.empty() ? 0 : runs.back().offset + (runs.back().base_end - runs.back().base_offset);
+            runs.push_back({ offset, end, run_offset });
+        }
+        else
+        {
+            runs.back().base_end = std::max(runs.back().base_end, end);
+        }
+
+        kept_offsets[i] = (std::uint32_t)(runs.back().offset + (offset - runs.back().base_offset));
+    }
+
+    std::uint64_t copied_size = runs.empty() ? 0 : runs.back().offset + (runs.back().base_end - runs.back().base_offset);
+
+    if (copied_size + added.size() > std::numeric_limits<std::uint32_t>::max())
+    {
+        return fail(error, "TLK string data would exceed 4 GB.");
+    }
+
+    std::size_t entries_size = (std::size_t)count * entry_size;
+    out->assign(header_size + entries_size + copied_size + added.size(), std::byte { 0 });
+
+    std::byte* header = out->data();
+    std::byte* entries = header + header_size;
+    std::byte* strings = entries + entries_size;
+
+    std::memcpy(header, "TLK V3.0", 8);
+    write_u32(header + 8, patch.language_id.value_or(view.language_id()));
+    write_u32(header + 12, (std::uint32_t)count);
+    write_u32(header + 16, (std::uint32_t)(header_size + entries_size));
+
+    for (const Run& run : runs)
+    {
+        std::memcpy(strings + run.offset, base_strings + run.base_offset, run.base_end - run.base_offset);
+    }
+
+    // Kept entries are copied as they are, with only their string moved; entries past the end of the base and
+    // deleted ones stay zeroed, which is an empty entry.
+    for (std::uint32_t i = 0; i < kept_count; ++i)
+    {
+        std::byte* entry = entries + (std::size_t)i * entry_size;
+        std::memcpy(entry, view.entry_data(i), entry_size);
+        write_u32(entry + string_offset_offset, kept_offsets[i]);
+    }
+
+    auto added_offset = std::begin(added_offsets);
+
+    for (const auto& [strref, entry] : patch.entries)
+    {
+        if (strref >= count) break;
+
+        std::byte* out_entry = entries + (std::size_t)strref * entry_size;
+        std::memset(out_entry, 0, entry_size);
+
+        if (entry)
+        {
+            encode_tlk_entry(*entry, entry->m_String ? (std::uint32_t)copied_size + *added_offset++ : 0, out_entry);
+        }
+    }
+
+    added.copy_to(strings + copied_size);
+
+    PROFILE_COUNT(ProfileCounter::Entries, patch.entries.size());
+    return true;
+}
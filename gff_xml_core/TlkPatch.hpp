@@ -0,0 +1,35 @@
+#pragma once
+
+#include "FileFormats/Tlk.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+// A set of changes to a talk table, as read from a delta XML by read_tlk_patch_xml.
+struct TlkPatch
+{
+    std::optional<std::uint32_t> language_id;
+
+    // Each entry replaces the base entry of the same StrRef outright; nullopt deletes it.
+    std::map<FileFormats::Tlk::Friendly::StrRef, std::optional<FileFormats::Tlk::Friendly::TlkEntry>> entries;
+
+    // How many entries the patched table has, where the caller knows better than the patch can tell; see below.
+    std::optional<std::uint32_t> entry_count;
+};
+
+// Applies patch to a binary talk table (V3.0) without decoding it. The string data of untouched entries is copied
+// through in as few runs as it is laid out in, leaving out whatever only changed or deleted entries referred to; only
+// the entry table and the strings of patched entries are encoded afresh. The cost is a pass over the entry table and
+// a copy of the string data, rather than a rebuild of the whole table. Strings the base shares between entries stay
+// shared, and identical strings among the patched entries are stored once.
+//
+// The table grows to take entries past its end. Deleting the last entries shrinks it, as if they had never been
+// added - though only as far as the first entry the patch leaves alone, empty or not, as the table doesn't say which
+// of its empty entries were ever added. An entry_count settles that, cutting or padding the table to that size; it
+// must take in every entry the patch adds. On failure, error describes what was wrong.
+bool apply_tlk_patch(const std::byte* base, std::size_t len, const TlkPatch& patch, std::vector<std::byte>* out,
+    std::string* error);
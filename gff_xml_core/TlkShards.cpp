@@ -0,0 +1,369 @@
+#include "TlkShards.hpp"
+#include "ContentHash.hpp"
+#include "FieldCodec.hpp"
+#include "MappedFile.hpp"
+#include "Profile.hpp"
+#include "TlkPatch.hpp"
+#include "TlkXml.hpp"
+#include "WorkPool.hpp"
+#include "XmlReader.hpp"
+#include "XmlWriter.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <string_view>
+#include <unordered_set>
+
+using namespace FileFormats::Tlk;
+using FieldCodecs::parse_value;
+
+namespace {
+
+constexpr const char* index_file = "index.xml";
+
+std::string shard_file_name(Friendly::StrRef first)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%08u.xml", (unsigned)first);
+    return name;
+}
+
+// Calls job(i, &error) for each of count shards, across the pool if there is one. A job that fails leaves a
+// description in error; the first in index order is the one reported.
+template <typename Job>
+bool run_shards(std::size_t count, WorkPool* pool, std::string* error, Job&& job)
+{
+    std::vector<std::string> errors(count);
+    std::vector<char> success(count, false);
+
+    auto run = [&](std::size_t i)
+    {
+        success[i] = job(i, &errors[i]);
+    };
+
+    if (pool)
+    {
+        pool->run(count, run);
+    }
+    else
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            run(i);
+        }
+    }
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (!success[i])
+        {
+            *error = std::move(errors[i]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool read_shard(const std::filesystem::path& dir, const TlkShardIndex& index, const TlkShard& shard, TlkPatch* out,
+    std::string* error)
+{
+    MappedFile data;
+    std::string shard_error;
+
+    if (!data.open(dir / shard.file))
+    {
+        *error = shard.file + ": Failed to read.";
+        return false;
+    }
+
+    PROFILE_COUNT(ProfileCounter::BytesIn, data.size());
+
+    if (!read_tlk_patch_xml(data.chars(), data.size(), out, &shard_error))
+    {
+        *error = shard.file + ": " + shard_error;
+        return false;
+    }
+
+    // Anything outside the range would be lost or clobber another shard's entries when patching.
+    if (!out->entries.empty() && (out->entries.begin()->first < shard.first
+        || out->entries.rbegin()->first - shard.first >= index.entries_per_shard))
+    {
+        *error = shard.file + ": Entry outside the shard's StrRef range.";
+        return false;
+    }
+
+    return true;
+}
+
+bool write_index(const std::filesystem::path& dir, const TlkShardIndex& index)
+{
+    FileUpdateSink sink(dir / index_file, true);
+    XmlWriter out(&sink);
+
+    out.open_element("TlkShards");
+    out.push_attribute("Version", 1);
+    out.push_attribute("LanguageId", (unsigned)index.language_id);
+    out.push_attribute("EntriesPerShard", (unsigned)index.entries_per_shard);
+
+    for (const TlkShard& shard : index.shards)
+    {
+        out.open_element("Shard");
+        out.push_attribute("First", (unsigned)shard.first);
+        out.push_attribute("File", shard.file.c_str());
+        out.close_element();
+    }
+
+    out.close_element();
+    return sink.finish() != FileUpdateSink::Result::Failed;
+}
+
+}
+
+bool read_tlk_shard_index(const std::filesystem::path& dir, TlkShardIndex* out, std::string* error)
+{
+    MappedFile data;
+
+    if (!data.open(dir / index_file))
+    {
+        *error = std::string(index_file) + ": Failed to read.";
+        return false;
+    }
+
+    XmlReader reader(data.chars(), data.size());
+    std::string_view attr;
+    bool success = false;
+
+    if (reader.next_element() != XmlReader::Token::StartElement || reader.name() != "TlkShards")
+    {
+        reader.fail("Expected a TlkShards root element.");
+    }
+    else if (reader.attribute("LanguageId", &attr) && !parse_value(attr, &out->language_id))
+    {
+        reader.fail("Malformed LanguageId.");
+    }
+    else if (reader.attribute("EntriesPerShard", &attr)
+        && (!parse_value(attr, &out->entries_per_shard) || out->entries_per_shard == 0))
+    {
+        reader.fail("Malformed EntriesPerShard.");
+    }
+    else
+    {
+        XmlReader::Token token;
+
+        while ((token = reader.next_element()) == XmlReader::Token::StartElement)
+        {
+            if (reader.name() != "Shard")
+            {
+                if (!reader.skip_element()) break;
+                continue;
+            }
+
+            TlkShard shard;
+
+            if (!reader.attribute("First", &attr) || !parse_value(attr, &shard.first)
+                || shard.first % out->entries_per_shard != 0)
+            {
+                reader.fail("Missing or malformed First.");
+                break;
+            }
+
+            if (!out->shards.empty() && shard.first <= out->shards.back().first)
+            {
+                reader.fail("Shards out of order.");
+                break;
+            }
+
+            // Shards live in the directory itself, never elsewhere.
+            if (!reader.attribute("File", &attr) || attr.empty() || attr == "." || attr == ".."
+                || std::filesystem::path(attr).filename() != std::filesystem::path(attr))
+            {
+                reader.fail("Missing or malformed File.");
+                break;
+            }
+
+            shard.file = attr;
+            out->shards.push_back(std::move(shard));
+            if (!reader.skip_element()) break;
+        }
+
+        success = token == XmlReader::Token::EndElement && !reader.failed();
+    }
+
+    if (!success)
+    {
+        *error = std::string(index_file) + ": " + reader.error();
+    }
+
+    return success;
+}
+
+bool write_tlk_shards(const Friendly::Tlk& tlk, const std::filesystem::path& dir, std::uint32_t entries_per_shard,
+    WorkPool* pool, std::string* error)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+
+    if (ec)
+    {
+        *error = dir.string() + ": Failed to create directory.";
+        return false;
+    }
+
+    // Whatever the old index listed is cleaned up afterwards. Without one there is nothing of ours to clean up.
+    TlkShardIndex previous;
+    std::string previous_error;
+    read_tlk_shard_index(dir, &previous, &previous_error);
+
+    TlkShardIndex index;
+    index.language_id = tlk.GetLanguageId();
+    index.entries_per_shard = entries_per_shard;
+
+    // The table is in StrRef order, so one pass finds where each shard's entries start.
+    std::vector<Friendly::Tlk::TlkMap::const_iterator> bounds;
+
+    for (auto iter = std::begin(tlk); iter != std::end(tlk); ++iter)
+    {
+        Friendly::StrRef first = iter->first - iter->first % entries_per_shard;
+
+        if (index.shards.empty() || index.shards.back().first != first)
+        {
+            index.shards.push_back({ first, shard_file_name(first) });
+            bounds.push_back(iter);
+        }
+    }
+
+    bounds.push_back(std::end(tlk));
+
+    bool success = run_shards(index.shards.size(), pool, error, [&](std::size_t i, std::string* shard_error)
+    {
+        FileUpdateSink sink(dir / index.shards[i].file, true);
+        write_tlk_xml(index.language_id, bounds[i], bounds[i + 1], &sink);
+
+        if (sink.finish() == FileUpdateSink::Result::Failed)
+        {
+            *shard_error = index.shards[i].file + ": Failed to write.";
+            return false;
+        }
+
+        return true;
+    });
+
+    if (!success) return false;
+
+    if (!write_index(dir, index))
+    {
+        *error = std::string(index_file) + ": Failed to write.";
+        return false;
+    }
+
+    std::unordered_set<std::string> current;
+
+    for (const TlkShard& shard : index.shards)
+    {
+        current.insert(shard.file);
+    }
+
+    for (const TlkShard& shard : previous.shards)
+    {
+        if (!current.count(shard.file))
+        {
+            std::filesystem::remove(dir / shard.file, ec);
+        }
+    }
+
+    return true;
+}
+
+bool hash_tlk_shards(const std::filesystem::path& dir, const TlkShardIndex& index, std::vector<std::uint64_t>* out,
+    WorkPool* pool, std::string* error)
+{
+    out->assign(index.shards.size(), 0);
+
+    return run_shards(index.shards.size(), pool, error, [&](std::size_t i, std::string* shard_error)
+    {
+        if (!hash_file(dir / index.shards[i].file, &(*out)[i]))
+        {
+            *shard_error = index.shards[i].file + ": Failed to read.";
+            return false;
+        }
+
+        return true;
+    });
+}
+
+bool read_tlk_shards(const std::filesystem::path& dir, const TlkShardIndex& index, Friendly::Tlk* out,
+    WorkPool* pool, std::string* error)
+{
+    std::vector<TlkPatch> parsed(index.shards.size());
+
+    bool success = run_shards(index.shards.size(), pool, error, [&](std::size_t i, std::string* shard_error)
+    {
+        return read_shard(dir, index, index.shards[i], &parsed[i], shard_error);
+    });
+
+    if (!success) return false;
+
+    out->SetLanguageId(index.language_id);
+
+    for (TlkPatch& shard : parsed)
+    {
+        for (auto& [strref, entry] : shard.entries)
+        {
+            if (entry)
+            {
+                out->Set(strref, std::move(*entry));
+                PROFILE_COUNT(ProfileCounter::Entries, 1);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool read_tlk_shard_patch(const std::filesystem::path& dir, const TlkShardIndex& index,
+    const std::vector<Friendly::StrRef>& firsts, TlkPatch* out, WorkPool* pool, std::string* error)
+{
+    std::vector<const TlkShard*> shards(firsts.size(), nullptr);
+    std::vector<TlkPatch> parsed(firsts.size());
+
+    for (std::size_t i = 0; i < firsts.size(); ++i)
+    {
+        auto shard = std::lower_bound(std::begin(index.shards), std::end(index.shards), firsts[i],
+            [](const TlkShard& shard, Friendly::StrRef first) { return shard.first < first; });
+
+        if (shard != std::end(index.shards) && shard->first == firsts[i])
+        {
+            shards[i] = &*shard;
+        }
+    }
+
+    bool success = run_shards(firsts.size(), pool, error, [&](std::size_t i, std::string* shard_error)
+    {
+        return !shards[i] || read_shard(dir, index, *shards[i], &parsed[i], shard_error);
+    });
+
+    if (!success) return false;
+
+    out->language_id = index.language_id;
+
+    for (std::size_t i = 0; i < firsts.size(); ++i)
+    {
+        auto entry = parsed[i].entries.begin();
+
+        for (std::uint64_t strref = firsts[i]; strref < (std::uint64_t)firsts[i] + index.entries_per_shard; ++strref)
+        {
+            if (entry != parsed[i].entries.end() && entry->first == strref)
+            {
+                out->entries[(Friendly::StrRef)strref] = std::move(entry->second);
+                ++entry;
+            }
+            else
+            {
+                out->entries[(Friendly::StrRef)strref].reset();
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "FileFormats/Tlk.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+class WorkPool;
+struct TlkPatch;
+
+// A talk table kept as a directory of tlk_xml files ("shards"), each holding the entries of one fixed range of
+// StrRefs, along with an index.xml listing them:
+//
+//   <TlkShards Version="1" LanguageId="0" EntriesPerShard="1000">
+//       <Shard First="0" File="00000000.xml"/>
+//       <Shard First="1000" File="00001000.xml"/>
+//   </TlkShards>
+//
+// Every entry in a shard has its StrRef, so a shard reads on its own and an edit touches one small file rather than
+// the whole table. Ranges without entries have no shard.
+
+constexpr std::uint32_t default_entries_per_shard = 1000;
+
+struct TlkShard
+{
+    FileFormats::Tlk::Friendly::StrRef first; // The shard holds [first, first + entries_per_shard).
+    std::string file; // Relative to the shard directory.
+};
+
+struct TlkShardIndex
+{
+    std::uint32_t language_id = 0;
+    std::uint32_t entries_per_shard = default_entries_per_shard;
+    std::vector<TlkShard> shards; // In StrRef order.
+};
+
+bool read_tlk_shard_index(const std::filesystem::path& dir, TlkShardIndex* out, std::string* error);
+
+// Writes tlk into dir, which is created if need be. Shards that come out the same as before are left untouched, and
+// shards listed by the previous index that no longer have any entries are removed.
+bool write_tlk_shards(const FileFormats::Tlk::Friendly::Tlk& tlk, const std::filesystem::path& dir,
+    std::uint32_t entries_per_shard, WorkPool* pool, std::string* error);
+
+// The content hash of each shard, in index order, for telling which have changed since an earlier build.
+bool hash_tlk_shards(const std::filesystem::path& dir, const TlkShardIndex& index, std::vector<std::uint64_t>* out,
+    WorkPool* pool, std::string* error);
+
+// Parses every shard into out, spread across the pool.
+bool read_tlk_shards(const std::filesystem::path& dir, const TlkShardIndex& index,
+    FileFormats::Tlk::Friendly::Tlk* out, WorkPool* pool, std::string* error);
+
+// Parses the shards for the ranges starting at each of firsts into a patch that replaces everything in those
+// ranges, deleting whatever a range's shard doesn't hold - all of it, if the range has no shard. Applied to a table
+// built from an earlier version of the shards, it brings that table up to date with the ranges given.
+bool read_tlk_shard_patch(const std::filesystem::path& dir, const TlkShardIndex& index,
+    const std::vector<FileFormats::Tlk::Friendly::StrRef>& firsts, TlkPatch* out, WorkPool* pool,
+    std::string* error);
@@ -0,0 +1,82 @@
+#include "TlkView.hpp"
+
+#include <cstring>
+
+using namespace FileFormats::Tlk;
+using namespace TlkFormat;
+
+namespace {
+
+std::uint32_t read_u32(const std::byte* pos)
+{
+    std::uint32_t value;
+    std::memcpy(&value, pos, sizeof(value));
+    return value;
+}
+
+}
+
+bool TlkView::open(const std::byte* data, std::size_t len)
+{
+    if (len < header_size || std::memcmp(data, "TLK ", 4) != 0) return fail("File is not a TLK.");
+    if (std::memcmp(data + 4, "V3.0", 4) != 0) return fail("Unsupported TLK version.");
+
+    std::uint32_t count = read_u32(data + 12);
+    std::uint64_t strings_offset = read_u32(data + 16);
+
+    if (strings_offset > len) return fail("TLK string data starts past the end of the file.");
+    if (header_size + (std::uint64_t)count * entry_size > strings_offset)
+    {
+        return fail("TLK entry table overlaps its string data.");
+    }
+
+    m_entries = data + header_size;
+    m_strings = data + strings_offset;
+    m_strings_size = len - (std::size_t)strings_offset;
+    m_language_id = read_u32(data + 8);
+    m_count = count;
+    return true;
+}
+
+bool TlkView::get(Friendly::StrRef strref, TlkEntryView* out) const
+{
+    if (strref >= m_count) return fail("StrRef out of range.");
+
+    const std::byte* entry = entry_data(strref);
+    std::uint32_t flags = read_u32(entry);
+    *out = {};
+
+    if (flags & text_present)
+    {
+        std::uint64_t offset = read_u32(entry + string_offset_offset);
+        std::uint64_t size = read_u32(entry + string_size_offset);
+        if (offset + size > m_strings_size) return fail("TLK string extends past the end of the file.");
+        out->string.emplace(reinterpret_cast<const char*>(m_strings + offset), (std::size_t)size);
+    }
+
+    if (flags & sound_present)
+    {
+        std::string_view resref(reinterpret_cast<const char*>(entry + resref_offset), resref_size);
+        out->sound_resref = resref.substr(0, resref.find('\0'));
+    }
+
+    if (flags & sound_length_present)
+    {
+        float length;
+        std::memcpy(&length, entry + sound_length_offset, sizeof(length));
+        out->sound_length = length;
+    }
+
+    return true;
+}
+
+const std::byte* TlkView::entry_data(Friendly::StrRef strref) const
+{
+    return m_entries + (std::size_t)strref * entry_size;
+}
+
+bool TlkView::fail(const char* message) const
+{
+    m_error = message;
+    return false;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "FileFormats/Tlk.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Layout of a binary talk table (V3.0): a header, then one fixed-size entry per StrRef, then the string data the
+// entries point into.
+namespace TlkFormat {
+
+// FileType[4], FileVersion[4], LanguageID, StringCount, StringEntriesOffset.
+constexpr std::size_t header_size = 20;
+
+// Flags, SoundResRef[16], VolumeVariance, PitchVariance, OffsetToString, StringSize, SoundLength. OffsetToString is
+// relative to the start of the string data.
+constexpr std::size_t entry_size = 40;
+constexpr std::size_t resref_offset = 4;
+constexpr std::size_t resref_size = 16;
+constexpr std::size_t string_offset_offset = 28;
+constexpr std::size_t string_size_offset = 32;
+constexpr std::size_t sound_length_offset = 36;
+
+constexpr std::uint32_t text_present = 0x1;
+constexpr std::uint32_t sound_present = 0x2;
+constexpr std::uint32_t sound_length_present = 0x4;
+
+// StrRefs at or above this refer to the alternate talk table, so no table holds more entries than this.
+constexpr std::uint64_t max_entries = 0x01000000;
+
+}
+
+// One entry as it is stored. Parts whose flag isn't set are absent; the rest point into the table's bytes.
+struct TlkEntryView
+{
+    std::optional<std::string_view> string;
+    std::optional<std::string_view> sound_resref; // Up to the first NUL.
+    std::optional<float> sound_length;
+};
+
+// Read-only view of a binary talk table that decodes nothing up front. open() only checks the header and that the
+// entry table is all there; looking up a StrRef then reads its entry and string in place, in constant time however
+// large the table. The bytes (usually a MappedFile) must outlive the view and everything obtained from it.
+class TlkView
+{
+public:
+    bool open(const std::byte* data, std::size_t len);
+
+    std::uint32_t language_id() const { return m_language_id; }
+    std::uint32_t size() const { return m_count; } // One past the highest StrRef in the table.
+
+    // Fails for a StrRef past the end of the table and for an entry whose string runs off the end of the data.
+    bool get(FileFormats::Tlk::Friendly::StrRef strref, TlkEntryView* out) const;
+
+    // The stored entry for a StrRef below size(), and the string data its offset is relative to, for carrying
+    // entries over without decoding them.
+    const std::byte* entry_data(FileFormats::Tlk::Friendly::StrRef strref) const;
+    const std::byte* string_data() const { return m_strings; }
+    std::size_t string_data_size() const { return m_strings_size; }
+
+    const char* error() const { return m_error; }
+
+private:
+    bool fail(const char* message) const;
+
+    const std::byte* m_entries = nullptr;
+    const std::byte* m_strings = nullptr;
+    std::size_t m_strings_size = 0;
+    std::uint32_t m_language_id = 0;
+    std::uint32_t m_count = 0;
+
+    mutable const char* m_error = "";
+};
@@ -0,0 +1,421 @@
+#include "TlkXml.hpp"
+#include "FieldCodec.hpp"
+#include "Profile.hpp"
+#include "TlkPatch.hpp"
+#include "WorkPool.hpp"
+#include "XmlReader.hpp"
+#include "XmlWriter.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace FileFormats::Tlk;
+using FieldCodecs::parse_value;
+
+namespace {
+
+// Work is cut into chunks of about this many entries, or the equivalent in XML, so that a few long descriptions
+// can't leave one thread with most of the table.
+constexpr std::size_t entries_per_chunk = 512;
+constexpr std::size_t bytes_per_chunk = 256 * 1024;
+
+// While writing, this many chunks per thread are formatted before they are written out in order and their buffers
+// reused, bounding memory use to a window of the table rather than all of it.
+constexpr std::size_t chunks_per_thread = 4;
+
+using ParsedEntry = std::pair<Friendly::StrRef, Friendly::TlkEntry>;
+
+bool read_entry(XmlReader& reader, ParsedEntry* out)
+{
+    std::string_view attr;
+    Friendly::StrRef& strref = out->first;
+    Friendly::TlkEntry& entry = out->second;
+
+    if (reader.attribute("StrRef", &attr) && !parse_value(attr, &strref))
+    {
+        return reader.fail("Malformed StrRef.");
+    }
+
+    XmlReader::Token token;
+
+    while ((token = reader.next_element()) == XmlReader::Token::StartElement)
+    {
+        std::string_view name = reader.name();
+        std::string_view text;
+
+        // The first of each wins, as it did when these were looked up with FirstChildElement.
+        if (name == "String" && !entry.m_String)
+        {
+            if (!reader.read_text(&text)) return false;
+
+            if (!text.empty())
+            {
+                entry.m_String.emplace(text);
+            }
+        }
+        else if (name == "SoundResRef" && !entry.m_SoundResRef)
+        {
+            if (!reader.read_text(&text)) return false;
+
+            if (!text.empty())
+            {
+                entry.m_SoundResRef.emplace(text);
+            }
+        }
+        else if (name == "SoundLength" && !entry.m_SoundLength)
+        {
+            float length = 0.0f;
+            if (!reader.read_text(&text)) return false;
+            if (!text.empty() && !parse_value(text, &length)) return reader.fail("Malformed SoundLength.");
+            entry.m_SoundLength = length;
+        }
+        else if (!reader.skip_element())
+        {
+            return false;
+        }
+    }
+
+    return token == XmlReader::Token::EndElement;
+}
+
+// Reads the children of the root up to its end tag - or, for a fragment, up to the end of the input - handing
+// each entry to add.
+template <typename Add>
+bool read_entries(XmlReader& reader, bool fragment, Add&& add)
+{
+    XmlReader::Token token;
+
+    while ((token = reader.next_element()) == XmlReader::Token::StartElement)
+    {
+        if (reader.name() != "Entry")
+        {
+            if (!reader.skip_element()) return false;
+            continue;
+        }
+
+        ParsedEntry entry {};
+        if (!read_entry(reader, &entry)) return false;
+        add(std::move(entry));
+    }
+
+    return token == (fragment ? XmlReader::Token::EndOfDocument : XmlReader::Token::EndElement) && !reader.failed();
+}
+
+// After the root's end tag, only whitespace and comments may follow; the reader fails on anything else.
+bool read_document_end(XmlReader& reader)
+{
+    return reader.next() == XmlReader::Token::EndOfDocument;
+}
+
+bool is_entry_start(const char* pos, const char* end)
+{
+    constexpr std::string_view tag = "<Entry";
+    if ((std::size_t)(end - pos) <= tag.size() || std::memcmp(pos, tag.data(), tag.size()) != 0) return false;
+    char next = pos[tag.size()];
+    return next == ' ' || next == '\t' || next == '\r' || next == '\n' || next == '/' || next == '>';
+}
+
+// Whether end is a well-formed </Tlk> followed by nothing but whitespace and comments, as the document's end must be.
+// Anything else - a second root, stray text - is left to reading in one piece, which reports it as it always has.
+bool is_root_end_tag(std::string_view end)
+{
+    std::size_t pos = end.find_first_not_of(" \t\r\n", 5);
+    if (pos == std::string_view::npos || end[pos] != '>') return false;
+
+    while ((pos = end.find_first_not_of(" \t\r\n", pos + 1)) != std::string_view::npos)
+    {
+        if (end.compare(pos, 4, "<!--") != 0) return false;
+
+        pos = end.find("-->", pos + 4);
+        if (pos == std::string_view::npos) return false;
+        pos += 2;
+    }
+
+    return true;
+}
+
+// Splits the root's content at <Entry tags spaced about bytes_per_chunk apart. The split is only a guess - a tag
+// could sit in a comment or inside some other element - but a chunk cut anywhere but between two children of the
+// root fails to parse as a fragment, so a bad guess costs a fallback to reading in one piece, never a wrong result.
+std::vector<std::string_view> split_entries(std::string_view body)
+{
+    std::vector<std::string_view> chunks;
+    const char* begin = body.data();
+    const char* end = begin + body.size();
+    const char* chunk_start = begin;
+
+    while (chunk_start != end)
+    {
+        const char* split = chunk_start + std::min<std::size_t>(bytes_per_chunk, end - chunk_start);
+
+        while (split != end && !is_entry_start(split, end))
+        {
+            split = std::find(split + 1, end, '<');
+        }
+
+        chunks.emplace_back(chunk_start, split - chunk_start);
+        chunk_start = split;
+    }
+
+    return chunks;
+}
+
+// Parses the content of the root in chunks across the pool, then merges them in document order so that a StrRef
+// given twice ends up exactly as it would reading in one piece. Returns false, leaving out untouched, if the content
+// doesn't split cleanly.
+bool read_entries_parallel(std::string_view body, Friendly::Tlk* out, WorkPool& pool)
+{
+    std::vector<std::string_view> chunks = split_entries(body);
+    std::vector<std::vector<ParsedEntry>> parsed(chunks.size());
+    std::vector<char> success(chunks.size(), false);
+
+    pool.run(chunks.size(), [&](std::size_t index)
+    {
+        thread_local XmlReader reader(nullptr, 0);
+        reader.reset_fragment(chunks[index].data(), chunks[index].size());
+        std::vector<ParsedEntry>& entries = parsed[index];
+        success[index] = read_entries(reader, true, [&](ParsedEntry&& entry) { entries.push_back(std::move(entry)); });
+    });
+
+    if (std::find(std::begin(success), std::end(success), false) != std::end(success)) return false;
+
+    for (std::vector<ParsedEntry>& entries : parsed)
+    {
+        for (ParsedEntry& entry : entries)
+        {
+            out->Set(entry.first, std::move(entry.second));
+        }
+
+        PROFILE_COUNT(ProfileCounter::Entries, entries.size());
+    }
+
+    return true;
+}
+
+void open_root(XmlWriter& out, std::uint32_t language_id)
+{
+    out.open_element("Tlk");
+    out.push_attribute("Version", 1);
+    out.push_attribute("LanguageId", (unsigned)language_id);
+}
+
+void write_entry(XmlWriter& out, Friendly::StrRef strref, const Friendly::TlkEntry& entry)
+{
+    out.open_element("Entry");
+    out.push_attribute("StrRef", (unsigned)strref);
+
+    if (entry.m_String)
+    {
+        out.open_element("String");
+        out.push_text(entry.m_String->c_str());
+        out.close_element();
+    }
+
+    if (entry.m_SoundResRef)
+    {
+        out.open_element("SoundResRef");
+        out.push_text(entry.m_SoundResRef->c_str());
+        out.close_element();
+    }
+
+    if (entry.m_SoundLength)
+    {
+        out.open_element("SoundLength");
+        out.push_text(*entry.m_SoundLength);
+        out.close_element();
+    }
+
+    out.close_element();
+}
+
+// Formats chunks of entries across the pool as fragments one level inside the root, and splices them into out in
+// order. Each fragment is exactly what out would have written for those entries itself.
+void write_entries_parallel(const Friendly::Tlk& tlk, XmlWriter& out, WorkPool& pool)
+{
+    std::vector<const Friendly::Tlk::TlkMap::value_type*> entries;
+
+    for (const auto& kvp : tlk)
+    {
+        entries.push_back(&kvp);
+    }
+
+    std::size_t window = pool.thread_count() * chunks_per_thread;
+    std::vector<std::vector<std::byte>> fragments(window);
+
+    for (std::size_t first = 0; first < entries.size(); first += window * entries_per_chunk)
+    {
+        std::size_t chunk_count = std::min(window, (entries.size() - first + entries_per_chunk - 1) / entries_per_chunk);
+
+        pool.run(chunk_count, [&](std::size_t index)
+        {
+            std::size_t begin = first + index * entries_per_chunk;
+            std::size_t end = std::min(begin + entries_per_chunk, entries.size());
+
+            std::vector<std::byte>& fragment = fragments[index];
+            fragment.clear();
+            MemorySink sink(&fragment);
+            XmlWriter writer(&sink, 1);
+
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                write_entry(writer, entries[i]->first, entries[i]->second);
+            }
+        });
+
+        for (std::size_t i = 0; i < chunk_count; ++i)
+        {
+            out.write_fragment(reinterpret_cast<const char*>(fragments[i].data()), fragments[i].size());
+        }
+    }
+
+    PROFILE_COUNT(ProfileCounter::Entries, entries.size());
+}
+
+}
+
+bool read_tlk_xml(const char* data, std::size_t len, Friendly::Tlk* out, std::string* error, WorkPool* pool)
+{
+    XmlReader reader(data, len);
+    std::string_view attr;
+    std::uint32_t language_id = 0;
+    bool success = false;
+
+    if (reader.next_element() != XmlReader::Token::StartElement || reader.name() != "Tlk")
+    {
+        reader.fail("Expected a Tlk root element.");
+    }
+    else if (reader.attribute("LanguageId", &attr) && !parse_value(attr, &language_id))
+    {
+        reader.fail("Malformed LanguageId.");
+    }
+    else
+    {
+        out->SetLanguageId(language_id);
+
+        // The root's content runs from the end of its start tag to the last end tag in the document, which had
+        // better be the root's own; if not, the fragments won't parse and we read in one piece after all.
+        std::string_view document(data, len);
+        std::size_t body_start = reader.offset();
+        std::size_t body_end = document.rfind("</Tlk");
+        bool parallel = pool && pool->thread_count() > 1 && body_end != std::string_view::npos && body_end > body_start
+            && is_root_end_tag(document.substr(body_end));
+
+        if (parallel && read_entries_parallel(document.substr(body_start, body_end - body_start), out, *pool))
+        {
+            success = true;
+        }
+        else
+        {
+            success = read_entries(reader, false, [&](ParsedEntry&& entry)
+            {
+                out->Set(entry.first, std::move(entry.second));
+                PROFILE_COUNT(ProfileCounter::Entries, 1);
+            }) && read_document_end(reader);
+        }
+    }
+
+    if (!success)
+    {
+        *error = reader.error();
+    }
+
+    return success;
+}
+
+bool read_tlk_patch_xml(const char* data, std::size_t len, TlkPatch* out, std::string* error)
+{
+    XmlReader reader(data, len);
+    std::string_view attr;
+    bool success = false;
+
+    if (reader.next_element() != XmlReader::Token::StartElement || reader.name() != "Tlk")
+    {
+        reader.fail("Expected a Tlk root element.");
+    }
+    else if (reader.attribute("LanguageId", &attr) && !parse_value(attr, &out->language_id.emplace()))
+    {
+        reader.fail("Malformed LanguageId.");
+    }
+    else
+    {
+        XmlReader::Token token;
+
+        while ((token = reader.next_element()) == XmlReader::Token::StartElement)
+        {
+            if (reader.name() != "Entry")
+            {
+                if (!reader.skip_element()) break;
+                continue;
+            }
+
+            // Unlike in a whole table, an entry can't stand for StrRef 0 by leaving it out.
+            if (!reader.attribute("StrRef", &attr))
+            {
+                reader.fail("Entry without a StrRef.");
+                break;
+            }
+
+            std::uint32_t deleted = 0;
+
+            if (reader.attribute("Deleted", &attr) && !parse_value(attr, &deleted))
+            {
+                reader.fail("Malformed Deleted.");
+                break;
+            }
+
+            ParsedEntry entry {};
+            if (!read_entry(reader, &entry)) break;
+
+            // A later entry for the same StrRef wins, as it would reading a whole table.
+            if (deleted)
+            {
+                out->entries[entry.first].reset();
+            }
+            else
+            {
+                out->entries[entry.first] = std::move(entry.second);
+            }
+        }
+
+        success = token == XmlReader::Token::EndElement && !reader.failed() && read_document_end(reader);
+    }
+
+    if (!success)
+    {
+        *error = reader.error();
+    }
+
+    return success;
+}
+
+void write_tlk_xml(const Friendly::Tlk& tlk, XmlSink* sink, WorkPool* pool)
+{
+    if (!pool || pool->thread_count() <= 1)
+    {
+        write_tlk_xml(tlk.GetLanguageId(), std::begin(tlk), std::end(tlk), sink);
+        return;
+    }
+
+    XmlWriter out(sink);
+    open_root(out, tlk.GetLanguageId());
+    write_entries_parallel(tlk, out, *pool);
+    out.close_element();
+}
+
+void write_tlk_xml(std::uint32_t language_id, Friendly::Tlk::TlkMap::const_iterator first,
+    Friendly::Tlk::TlkMap::const_iterator last, XmlSink* sink)
+{
+    XmlWriter out(sink);
+    open_root(out, language_id);
+
+    for (; first != last; ++first)
+    {
+        write_entry(out, first->first, first->second);
+        PROFILE_COUNT(ProfileCounter::Entries, 1);
+    }
+
+    out.close_element();
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "FileFormats/Tlk.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class WorkPool;
+class XmlSink;
+struct TlkPatch;
+
+// Streaming conversion between Friendly::Tlk and tlk_xml's XML form:
+//
+//   <Tlk Version="1" LanguageId="0">
+//       <Entry StrRef="0">
+//           <String>...</String>
+//           <SoundResRef>...</SoundResRef>
+//           <SoundLength>...</SoundLength>
+//       </Entry>
+//   </Tlk>
+//
+// Neither direction builds a DOM, so converting a talk table costs little beyond the Friendly::Tlk itself. Output is
+// byte-identical to what tinyxml2 produced for the same table.
+//
+// Given a pool with more than one thread, both directions also split the table into chunks and work on them in
+// parallel, with results identical to working through it in sequence.
+
+// Parses entries straight into out as they are read. Each part of an entry is optional; unknown elements are
+// skipped, and an empty String counts as absent. On failure, error describes what was wrong.
+bool read_tlk_xml(const char* data, std::size_t len, FileFormats::Tlk::Friendly::Tlk* out, std::string* error,
+    WorkPool* pool = nullptr);
+
+// Reads a delta for apply_tlk_patch. It takes the same form as a whole table but holds only the entries that change,
+// each of which must have a StrRef; <Entry StrRef="12" Deleted="1"/> deletes one. A LanguageId on the root replaces
+// the base's, which is kept otherwise.
+bool read_tlk_patch_xml(const char* data, std::size_t len, TlkPatch* out, std::string* error);
+
+// Emits each entry as it iterates tlk.
+void write_tlk_xml(const FileFormats::Tlk::Friendly::Tlk& tlk, XmlSink* sink, WorkPool* pool = nullptr);
+
+// Emits a table of only the entries in [first, last), as for one shard of a sharded table.
+void write_tlk_xml(std::uint32_t language_id, FileFormats::Tlk::Friendly::Tlk::TlkMap::const_iterator first,
+    FileFormats::Tlk::Friendly::Tlk::TlkMap::const_iterator last, XmlSink* sink);
@@ -0,0 +1,92 @@
+#include "WorkPool.hpp"
+
+#include <algorithm>
+#include <thread>
+
+WorkPool::WorkPool(std::size_t thread_count)
+    : m_thread_count(std::max<std::size_t>(thread_count, 1))
+{ }
+
+void WorkPool::run(std::size_t job_count, const std::function<void(std::size_t)>& job)
+{
+    std::size_t worker_count = std::min(m_thread_count, job_count);
+
+    if (worker_count <= 1)
+    {
+        for (std::size_t i = 0; i < job_count; ++i)
+        {
+            job(i);
+        }
+
+        return;
+    }
+
+    std::vector<Queue> queues(worker_count);
+
+    for (std::size_t i = 0; i < job_count; ++i)
+    {
+        queues[i % worker_count].jobs.push_back(i);
+    }
+
+    auto worker = [&](std::size_t self)
+    {
+        std::size_t index;
+
+        while (take_job(queues, self, &index))
+        {
+            job(index);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(worker_count - 1);
+
+    for (std::size_t i = 1; i < worker_count; ++i)
+    {
+        threads.emplace_back(worker, i);
+    }
+
+    worker(0);
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+std::size_t WorkPool::hardware_thread_count()
+{
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+bool WorkPool::take_job(std::vector<Queue>& queues, std::size_t self, std::size_t* out)
+{
+    {
+        Queue& own = queues[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+
+        if (!own.jobs.empty())
+        {
+            *out = own.jobs.front();
+            own.jobs.pop_front();
+            return true;
+        }
+    }
+
+    // Nothing left locally - steal from the back of everyone else, starting with our neighbour.
+    // Jobs are never added once run() starts, so a single pass that finds nothing means we're done.
+    for (std::size_t i = 1; i < queues.size(); ++i)
+    {
+        Queue& victim = queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+
+        if (!victim.jobs.empty())
+        {
+            *out = victim.jobs.back();
+            victim.jobs.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
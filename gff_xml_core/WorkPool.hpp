@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Runs a fixed batch of jobs across a set of threads.
+// Each worker owns a queue seeded round-robin with job indices. It takes work from the front of its own queue and,
+// once that runs dry, steals from the back of the other queues, so a few slow jobs can't leave the rest of the pool idle.
+class WorkPool
+{
+public:
+    WorkPool(std::size_t thread_count);
+
+    // Calls job(i) for every i in [0, job_count) and returns once they have all finished.
+    // The calling thread takes part as one of the workers.
+    void run(std::size_t job_count, const std::function<void(std::size_t)>& job);
+
+    std::size_t thread_count() const { return m_thread_count; }
+
+    static std::size_t hardware_thread_count();
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<std::size_t> jobs;
+    };
+
+    bool take_job(std::vector<Queue>& queues, std::size_t self, std::size_t* out);
+
+    std::size_t m_thread_count;
+};
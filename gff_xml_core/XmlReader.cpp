@@ -0,0 +1,478 @@
+#include "XmlReader.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+bool is_whitespace(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+bool is_name_char(char ch)
+{
+    return !is_whitespace(ch) && ch != '/' && ch != '>' && ch != '=' && ch != '<' && ch != '\0';
+}
+
+bool starts_with(const char* pos, const char* end, const char* prefix)
+{
+    std::size_t len = std::strlen(prefix);
+    return (std::size_t)(end - pos) >= len && std::memcmp(pos, prefix, len) == 0;
+}
+
+void append_utf8(std::uint32_t cp, std::string* out)
+{
+    if (cp < 0x80)
+    {
+        out->push_back((char)cp);
+    }
+    else if (cp < 0x800)
+    {
+        out->push_back((char)(0xC0 | (cp >> 6)));
+        out->push_back((char)(0x80 | (cp & 0x3F)));
+    }
+    else if (cp < 0x10000)
+    {
+        out->push_back((char)(0xE0 | (cp >> 12)));
+        out->push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+        out->push_back((char)(0x80 | (cp & 0x3F)));
+    }
+    else
+    {
+        out->push_back((char)(0xF0 | (cp >> 18)));
+        out->push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+        out->push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+        out->push_back((char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+}
+
+XmlReader::XmlReader(const char* data, std::size_t len)
+{
+    reset(data, len);
+}
+
+void XmlReader::reset(const char* data, std::size_t len)
+{
+    m_begin = data;
+    m_pos = data;
+    m_end = data + len;
+    m_open.clear();
+    m_attributes.clear();
+    m_name = std::string_view();
+    m_text = std::string_view();
+    m_pending_end = false;
+    m_seen_root = false;
+    m_fragment = false;
+    m_failed = false;
+    m_error.clear();
+    m_error_pos = data;
+
+    // Skip a UTF-8 BOM, as tinyxml2 does.
+    if (starts_with(m_pos, m_end, "\xEF\xBB\xBF"))
+    {
+        m_pos += 3;
+    }
+}
+
+void XmlReader::reset_fragment(const char* data, std::size_t len)
+{
+    reset(data, len);
+    m_fragment = true;
+}
+
+XmlReader::Token XmlReader::next()
+{
+    if (m_failed) return Token::Error;
+
+    if (m_pending_end)
+    {
+        // Second half of a self-closing tag. m_name still holds the element name.
+        m_pending_end = false;
+        m_open.pop_back();
+        return Token::EndElement;
+    }
+
+    while (true)
+    {
+        if (m_pos == m_end)
+        {
+            if (!m_open.empty()) return fail_token("Unexpected end of document.");
+            if (!m_seen_root && !m_fragment) return fail_token("No root element.");
+            return Token::EndOfDocument;
+        }
+
+        if (*m_pos != '<')
+        {
+            const char* start = m_pos;
+            m_pos = std::find(m_pos, m_end, '<');
+            std::string_view raw(start, m_pos - start);
+
+            if (std::all_of(raw.begin(), raw.end(), is_whitespace)) continue;
+            if (m_open.empty() && !m_fragment) return fail_token("Text outside of the root element.");
+
+            if (raw.find_first_of("&\r") == std::string_view::npos)
+            {
+                m_text = raw;
+            }
+            else
+            {
+                if (!decode(raw, &m_text_scratch)) return fail_token("Malformed entity in text.");
+                m_text = m_text_scratch;
+            }
+
+            return Token::Text;
+        }
+
+        if (starts_with(m_pos, m_end, "<![CDATA["))
+        {
+            const char* start = m_pos + 9;
+            m_pos = start;
+            if (!skip_past("]]>")) return fail_token("Unterminated CDATA section.");
+            if (m_open.empty() && !m_fragment) return fail_token("CDATA outside of the root element.");
+            m_text = std::string_view(start, m_pos - 3 - start);
+            return Token::Text;
+        }
+
+        if (starts_with(m_pos, m_end, "<?") || starts_with(m_pos, m_end, "<!"))
+        {
+            if (!skip_markup()) return Token::Error;
+            continue;
+        }
+
+        if (starts_with(m_pos, m_end, "</"))
+        {
+            return parse_end_tag();
+        }
+
+        return parse_start_tag();
+    }
+}
+
+XmlReader::Token XmlReader::next_element()
+{
+    Token token;
+
+    do
+    {
+        token = next();
+    } while (token == Token::Text);
+
+    return token;
+}
+
+bool XmlReader::attribute(std::string_view name, std::string_view* out)
+{
+    for (const Attribute& attr : m_attributes)
+    {
+        if (attr.name != name) continue;
+
+        if (!attr.needs_decode)
+        {
+            *out = attr.raw_value;
+        }
+        else
+        {
+            if (!decode(attr.raw_value, &m_attribute_scratch)) return fail("Malformed entity in attribute.");
+            *out = m_attribute_scratch;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+bool XmlReader::read_text(std::string_view* out)
+{
+    bool first = true;
+    *out = std::string_view();
+
+    while (true)
+    {
+        switch (next())
+        {
+            case Token::Text:
+                if (first)
+                {
+                    if (m_text.data() == m_text_scratch.data())
+                    {
+                        // Decoded text lives in scratch that the next token would overwrite; move it out of the way.
+                        std::swap(m_text_scratch, m_read_text_scratch);
+                        m_text = m_read_text_scratch;
+                    }
+
+                    *out = m_text;
+                    first = false;
+                }
+                else
+                {
+                    // Text split by a comment or CDATA section - stitch the pieces together.
+                    if (out->data() != m_read_text_scratch.data())
+                    {
+                        m_read_text_scratch.assign(*out);
+                    }
+
+                    m_read_text_scratch.append(m_text);
+                    *out = m_read_text_scratch;
+                }
+                break;
+
+            case Token::EndElement:
+                return true;
+
+            case Token::StartElement:
+                return fail("Unexpected child element in text-only element.");
+
+            default:
+                return false;
+        }
+    }
+}
+
+bool XmlReader::skip_element()
+{
+    std::size_t depth = m_open.size();
+
+    while (m_open.size() >= depth)
+    {
+        Token token = next();
+        if (token == Token::Error || token == Token::EndOfDocument) return false;
+    }
+
+    return true;
+}
+
+bool XmlReader::fail(const char* message)
+{
+    if (!m_failed)
+    {
+        m_failed = true;
+        m_error = message;
+        m_error_pos = m_pos;
+    }
+
+    return false;
+}
+
+std::string XmlReader::error() const
+{
+    std::size_t line = 1 + std::count(m_begin, m_error_pos, '\n');
+    return "Line " + std::to_string(line) + ": " + m_error;
+}
+
+XmlReader::Token XmlReader::fail_token(const char* message)
+{
+    fail(message);
+    return Token::Error;
+}
+
+XmlReader::Token XmlReader::parse_start_tag()
+{
+    if (m_seen_root && m_open.empty() && !m_fragment) return fail_token("Multiple root elements.");
+
+    ++m_pos; // <
+    const char* name_start = m_pos;
+    while (m_pos != m_end && is_name_char(*m_pos)) ++m_pos;
+    if (m_pos == name_start) return fail_token("Malformed element name.");
+
+    m_name = std::string_view(name_start, m_pos - name_start);
+    m_attributes.clear();
+
+    while (true)
+    {
+        skip_whitespace();
+        if (m_pos == m_end) return fail_token("Unterminated start tag.");
+
+        if (*m_pos == '>')
+        {
+            ++m_pos;
+            break;
+        }
+
+        if (*m_pos == '/')
+        {
+            if (!starts_with(m_pos, m_end, "/>")) return fail_token("Malformed self-closing tag.");
+            m_pos += 2;
+            m_pending_end = true;
+            break;
+        }
+
+        const char* attr_start = m_pos;
+        while (m_pos != m_end && is_name_char(*m_pos)) ++m_pos;
+        if (m_pos == attr_start) return fail_token("Malformed attribute name.");
+        std::string_view attr_name(attr_start, m_pos - attr_start);
+
+        skip_whitespace();
+        if (m_pos == m_end || *m_pos != '=') return fail_token("Expected '=' after attribute name.");
+        ++m_pos;
+        skip_whitespace();
+        if (m_pos == m_end || (*m_pos != '"' && *m_pos != '\'')) return fail_token("Expected quoted attribute value.");
+
+        char quote = *m_pos++;
+        const char* value_start = m_pos;
+        m_pos = std::find(m_pos, m_end, quote);
+        if (m_pos == m_end) return fail_token("Unterminated attribute value.");
+
+        std::string_view raw_value(value_start, m_pos - value_start);
+        ++m_pos;
+
+        m_attributes.push_back({ attr_name, raw_value, raw_value.find_first_of("&\r") != std::string_view::npos });
+    }
+
+    m_open.push_back(m_name);
+    m_seen_root = true;
+    return Token::StartElement;
+}
+
+XmlReader::Token XmlReader::parse_end_tag()
+{
+    m_pos += 2; // </
+    const char* name_start = m_pos;
+    while (m_pos != m_end && is_name_char(*m_pos)) ++m_pos;
+    std::string_view name(name_start, m_pos - name_start);
+    skip_whitespace();
+
+    if (m_pos == m_end || *m_pos != '>') return fail_token("Malformed end tag.");
+    ++m_pos;
+
+    if (m_open.empty() || m_open.back() != name) return fail_token("Mismatched end tag.");
+
+    m_open.pop_back();
+    m_name = name;
+    m_attributes.clear();
+    return Token::EndElement;
+}
+
+bool XmlReader::skip_markup()
+{
+    if (starts_with(m_pos, m_end, "<?"))
+    {
+        return skip_past("?>") || fail("Unterminated processing instruction.");
+    }
+
+    if (starts_with(m_pos, m_end, "<!--"))
+    {
+        return skip_past("-->") || fail("Unterminated comment.");
+    }
+
+    // <!DOCTYPE ...> and friends. Internal subsets aren't supported - nothing we read uses them.
+    return skip_past(">") || fail("Unterminated declaration.");
+}
+
+bool XmlReader::skip_past(const char* terminator)
+{
+    std::string_view rest(m_pos, m_end - m_pos);
+    std::size_t found = rest.find(terminator);
+    if (found == std::string_view::npos) return false;
+    m_pos += found + std::strlen(terminator);
+    return true;
+}
+
+void XmlReader::skip_whitespace()
+{
+    while (m_pos != m_end && is_whitespace(*m_pos)) ++m_pos;
+}
+
+bool XmlReader::decode(std::string_view raw, std::string* out)
+{
+    static constexpr struct { const char* name; char value; } entities[] =
+    {
+        { "quot;", '"' }, { "amp;", '&' }, { "apos;", '\'' }, { "lt;", '<' }, { "gt;", '>' }
+    };
+
+    out->clear();
+    out->reserve(raw.size());
+
+    for (std::size_t i = 0; i < raw.size(); ++i)
+    {
+        char ch = raw[i];
+
+        if (ch == '\r')
+        {
+            out->push_back('\n');
+            if (i + 1 < raw.size() && raw[i + 1] == '\n') ++i;
+            continue;
+        }
+
+        if (ch != '&')
+        {
+            out->push_back(ch);
+            continue;
+        }
+
+        std::string_view rest = raw.substr(i + 1);
+
+        if (!rest.empty() && rest[0] == '#')
+        {
+            std::size_t semi = rest.find(';');
+            if (semi == std::string_view::npos || semi < 2) return false;
+
+            bool hex = rest[1] == 'x';
+            std::string_view digits = rest.substr(hex ? 2 : 1, semi - (hex ? 2 : 1));
+            if (digits.empty()) return false;
+
+            std::uint32_t cp = 0;
+
+            for (char digit : digits)
+            {
+                std::uint32_t value;
+                if (digit >= '0' && digit <= '9') value = digit - '0';
+                else if (hex && digit >= 'a' && digit <= 'f') value = digit - 'a' + 10;
+                else if (hex && digit >= 'A' && digit <= 'F') value = digit - 'A' + 10;
+                else return false;
+
+                cp = cp * (hex ? 16 : 10) + value;
+                if (cp > 0x10FFFF) return false;
+            }
+
+            append_utf8(cp, out);
+            i += semi + 1;
+            continue;
+        }
+
+        bool matched = false;
+
+        for (const auto& entity : entities)
+        {
+            std::size_t len = std::strlen(entity.name);
+
+            if (rest.substr(0, len) == entity.name)
+            {
+                out->push_back(entity.value);
+                i += len;
+                matched = true;
+                break;
+            }
+        }
+
+        if (!matched)
+        {
+            // Unknown entity - tinyxml2 passes these through untouched, so do the same.
+            out->push_back('&');
+        }
+    }
+
+    return true;
+}
+
+void XmlReader::read_back(std::string_view text, std::string* out)
+{
+    out->clear();
+    if (std::all_of(text.begin(), text.end(), is_whitespace)) return;
+
+    for (std::size_t i = 0; i < text.size(); ++i)
+    {
+        if (text[i] == '\r')
+        {
+            out->push_back('\n');
+            if (i + 1 < text.size() && text[i + 1] == '\n') ++i;
+            continue;
+        }
+
+        out->push_back(text[i]);
+    }
+}
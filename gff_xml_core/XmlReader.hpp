@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Pull parser over an in-memory XML document. Tokens are produced one at a time straight from the input bytes,
+// so nothing beyond the stack of open element names is kept around - there is no DOM.
+// Follows tinyxml2's reading rules where they matter to us: whitespace-only text between elements is dropped,
+// the five named entities and numeric character references are decoded, and line endings are normalised to \n.
+// The input buffer must outlive the reader; names, attribute values and text are views into it where possible.
+class XmlReader
+{
+public:
+    enum class Token
+    {
+        StartElement,
+        EndElement,
+        Text,
+        EndOfDocument,
+        Error
+    };
+
+    XmlReader(const char* data, std::size_t len);
+
+    // Starts over on a new document, keeping the memory already allocated for element stacks and decoded text.
+    void reset(const char* data, std::size_t len);
+
+    // Starts over on a run of sibling elements cut from inside some document's root, as when a large document is
+    // split up to be parsed in parallel. Any number of elements, text included, may sit at the top level.
+    void reset_fragment(const char* data, std::size_t len);
+
+    // Bytes of input consumed so far.
+    std::size_t offset() const { return (std::size_t)(m_pos - m_begin); }
+
+    Token next();
+
+    // Like next(), but skips over text - the equivalent of walking child elements in a DOM.
+    Token next_element();
+
+    // Valid after StartElement and EndElement.
+    std::string_view name() const { return m_name; }
+
+    // Valid after StartElement. The returned view is invalidated by the next call to attribute() or next().
+    bool attribute(std::string_view name, std::string_view* out);
+
+    // Valid after Text.
+    std::string_view text() const { return m_text; }
+
+    // Valid after StartElement. Reads the rest of the element as text, consuming its end tag.
+    // An element with no text yields an empty view; an element with child elements is an error.
+    bool read_text(std::string_view* out);
+
+    // Valid after StartElement. Consumes everything up to and including the matching end tag.
+    bool skip_element();
+
+    // Puts the reader into the error state with the given message. Always returns false.
+    bool fail(const char* message);
+
+    bool failed() const { return m_failed; }
+
+    // The error message, prefixed with the line on which it was detected.
+    std::string error() const;
+
+    // What read_text yields for an element whose text was written as text, escaped: whitespace-only text is dropped
+    // and line endings come back as \n. Everything else survives.
+    static void read_back(std::string_view text, std::string* out);
+
+private:
+    struct Attribute
+    {
+        std::string_view name;
+        std::string_view raw_value;
+        bool needs_decode;
+    };
+
+    Token fail_token(const char* message);
+    Token parse_start_tag();
+    Token parse_end_tag();
+    bool skip_markup();
+    bool skip_past(const char* terminator);
+    void skip_whitespace();
+
+    static bool decode(std::string_view raw, std::string* out);
+
+    const char* m_begin;
+    const char* m_pos;
+    const char* m_end;
+
+    std::vector<std::string_view> m_open;
+    std::vector<Attribute> m_attributes;
+    std::string_view m_name;
+    std::string_view m_text;
+    bool m_pending_end;
+    bool m_seen_root;
+    bool m_fragment;
+
+    std::string m_attribute_scratch;
+    std::string m_text_scratch;
+    std::string m_read_text_scratch;
+
+    bool m_failed;
+    std::string m_error;
+    const char* m_error_pos;
+};
@@ -0,0 +1,426 @@
+#include "XmlWriter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+
+#if defined(_WIN32)
+    #include <process.h>
+#else
+    #include <unistd.h>
+#endif
+
+namespace {
+
+// A temporary name next to path that no other sink - in this process or another - is using, so that two sinks
+// resolving to the same target never write into one temporary.
+std::filesystem::path temp_path_for(const std::filesystem::path& path)
+{
+    static std::atomic<unsigned long> counter { 0 };
+
+#if defined(_WIN32)
+    unsigned long pid = (unsigned long)_getpid();
+#else
+    unsigned long pid = (unsigned long)::getpid();
+#endif
+
+    std::filesystem::path temp = path;
+    temp += "." + std::to_string(pid) + "." + std::to_string(counter++) + ".tmp";
+    return temp;
+}
+
+}
+
+XmlFileSink::XmlFileSink(std::FILE* file, std::vector<char>* buffer)
+    : m_file(file), m_buffer(buffer ? *buffer : m_own_buffer), m_used(0), m_failed(false)
+{
+    m_buffer.resize(64 * 1024);
+}
+
+XmlFileSink::~XmlFileSink()
+{
+    flush();
+}
+
+void XmlFileSink::write(const char* data, std::size_t len)
+{
+    if (m_used + len > m_buffer.size())
+    {
+        flush();
+
+        if (len > m_buffer.size())
+        {
+            m_failed |= std::fwrite(data, 1, len, m_file) != len;
+            return;
+        }
+    }
+
+    std::memcpy(m_buffer.data() + m_used, data, len);
+    m_used += len;
+}
+
+bool XmlFileSink::flush()
+{
+    if (m_used)
+    {
+        m_failed |= std::fwrite(m_buffer.data(), 1, m_used, m_file) != m_used;
+        m_used = 0;
+    }
+
+    return !m_failed;
+}
+
+XmlWriter::XmlWriter(XmlSink* sink)
+    : m_sink(sink), m_depth(0), m_text_depth(-1), m_element_just_opened(false), m_first_element(true)
+{ }
+
+XmlWriter::XmlWriter(XmlSink* sink, int depth)
+    : m_sink(sink), m_depth(depth), m_text_depth(-1), m_element_just_opened(false), m_first_element(false)
+{ }
+
+void XmlWriter::write_fragment(const char* data, std::size_t len)
+{
+    seal_element_if_just_opened();
+    write(data, len);
+}
+
+void XmlWriter::open_element(const char* name)
+{
+    seal_element_if_just_opened();
+    m_stack.push_back(name);
+
+    if (m_text_depth < 0 && !m_first_element)
+    {
+        put_char('\n');
+    }
+
+    print_space(m_depth);
+    put_char('<');
+    write(name);
+
+    m_element_just_opened = true;
+    m_first_element = false;
+    ++m_depth;
+}
+
+void XmlWriter::push_attribute(const char* name, const char* value)
+{
+    put_char(' ');
+    write(name);
+    write("=\"", 2);
+    print_string(value, false);
+    put_char('\"');
+}
+
+void XmlWriter::push_attribute(const char* name, int value)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%d", value);
+    push_attribute(name, buf);
+}
+
+void XmlWriter::push_attribute(const char* name, unsigned value)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%u", value);
+    push_attribute(name, buf);
+}
+
+void XmlWriter::push_text(const char* text)
+{
+    m_text_depth = m_depth - 1;
+    seal_element_if_just_opened();
+    print_string(text, true);
+}
+
+void XmlWriter::push_text(int value)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%d", value);
+    push_text(buf);
+}
+
+void XmlWriter::push_text(unsigned value)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%u", value);
+    push_text(buf);
+}
+
+void XmlWriter::push_text(std::int64_t value)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%lld", (long long)value);
+    push_text(buf);
+}
+
+void XmlWriter::push_text(std::uint64_t value)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%llu", (unsigned long long)value);
+    push_text(buf);
+}
+
+void XmlWriter::push_text(float value)
+{
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%.8g", value);
+    push_text(buf);
+}
+
+void XmlWriter::push_text(double value)
+{
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%.17g", value);
+    push_text(buf);
+}
+
+void XmlWriter::close_element()
+{
+    --m_depth;
+    const char* name = m_stack.back();
+    m_stack.pop_back();
+
+    if (m_element_just_opened)
+    {
+        write("/>", 2);
+    }
+    else
+    {
+        if (m_text_depth < 0)
+        {
+            put_char('\n');
+            print_space(m_depth);
+        }
+
+        write("</", 2);
+        write(name);
+        put_char('>');
+    }
+
+    if (m_text_depth == m_depth)
+    {
+        m_text_depth = -1;
+    }
+
+    if (m_depth == 0)
+    {
+        put_char('\n');
+    }
+
+    m_element_just_opened = false;
+}
+
+void XmlWriter::seal_element_if_just_opened()
+{
+    if (m_element_just_opened)
+    {
+        m_element_just_opened = false;
+        put_char('>');
+    }
+}
+
+void XmlWriter::print_space(int depth)
+{
+    for (int i = 0; i < depth; ++i)
+    {
+        write("    ", 4);
+    }
+}
+
+void XmlWriter::print_string(const char* str, bool restricted)
+{
+    // Text only escapes & < >; attribute values also escape both quote characters - same split as tinyxml2.
+    const char* run = str;
+
+    for (const char* p = str; *p; ++p)
+    {
+        const char* entity = nullptr;
+
+        switch (*p)
+        {
+            case '&': entity = "&amp;"; break;
+            case '<': entity = "&lt;"; break;
+            case '>': entity = "&gt;"; break;
+            case '\"': entity = restricted ? nullptr : "&quot;"; break;
+            case '\'': entity = restricted ? nullptr : "&apos;"; break;
+            default: break;
+        }
+
+        if (entity)
+        {
+            write(run, p - run);
+            write(entity);
+            run = p + 1;
+        }
+    }
+
+    write(run);
+}
+
+void XmlWriter::write(const char* str)
+{
+    write(str, std::strlen(str));
+}
+
+FileUpdateSink::FileUpdateSink(std::filesystem::path path, bool text, SinkBuffers* buffers)
+    : m_path(std::move(path)), m_text(text), m_existing(nullptr), m_temp(nullptr),
+      m_matched(0), m_matching(true), m_failed(false), m_buffers(buffers ? *buffers : m_own_buffers)
+{
+    m_temp_path = temp_path_for(m_path);
+    m_existing = std::fopen(m_path.string().c_str(), m_text ? "r" : "rb");
+    m_matching = m_existing != nullptr;
+    m_buffers.pending.clear();
+    m_buffers.pending.reserve(block_size);
+}
+
+FileUpdateSink::~FileUpdateSink()
+{
+    m_temp_sink.reset();
+    if (m_existing) std::fclose(m_existing);
+
+    if (m_temp)
+    {
+        // finish() was never reached - don't leave a half-written temporary lying around.
+        std::fclose(m_temp);
+        std::error_code ec;
+        std::filesystem::remove(m_temp_path, ec);
+    }
+}
+
+void FileUpdateSink::write(const char* data, std::size_t len)
+{
+    // XmlWriter hands over output a few bytes at a time; batch it up before comparing.
+    std::vector<char>& pending = m_buffers.pending;
+
+    if (pending.size() + len > block_size)
+    {
+        process(pending.data(), pending.size());
+        pending.clear();
+
+        // Whole documents arrive in one go; keep the comparison to a block at a time all the same.
+        while (len > block_size)
+        {
+            process(data, block_size);
+            data += block_size;
+            len -= block_size;
+        }
+    }
+
+    pending.insert(std::end(pending), data, data + len);
+}
+
+void FileUpdateSink::process(const char* data, std::size_t len)
+{
+    if (m_failed || !len) return;
+
+    if (m_matching)
+    {
+        std::vector<char>& compare = m_buffers.compare;
+        compare.resize(len);
+
+        if (std::fread(compare.data(), 1, len, m_existing) == len && std::memcmp(compare.data(), data, len) == 0)
+        {
+            m_matched += len;
+            return;
+        }
+
+        if (!diverge()) return;
+    }
+    else if (!m_temp_sink && !diverge())
+    {
+        return;
+    }
+
+    m_temp_sink->write(data, len);
+}
+
+FileUpdateSink::Result FileUpdateSink::finish()
+{
+    process(m_buffers.pending.data(), m_buffers.pending.size());
+    m_buffers.pending.clear();
+
+    if (!m_failed && m_matching)
+    {
+        // Everything matched so far - unchanged only if the old file doesn't carry on past the new content.
+        if (std::fgetc(m_existing) == EOF) return Result::Unchanged;
+        diverge();
+    }
+    else if (!m_failed && !m_temp_sink)
+    {
+        diverge(); // No existing file and nothing written - still need to create an empty one.
+    }
+
+    if (m_failed) return Result::Failed;
+
+    bool flushed = m_temp_sink->flush();
+    m_temp_sink.reset();
+
+    bool closed = std::fclose(m_temp) == 0;
+    m_temp = nullptr;
+
+    if (m_existing)
+    {
+        std::fclose(m_existing);
+        m_existing = nullptr;
+    }
+
+    std::error_code ec;
+
+    if (!flushed || !closed)
+    {
+        std::filesystem::remove(m_temp_path, ec);
+        return Result::Failed;
+    }
+
+    std::filesystem::rename(m_temp_path, m_path, ec);
+
+    if (ec)
+    {
+        std::filesystem::remove(m_temp_path, ec);
+        return Result::Failed;
+    }
+
+    return Result::Written;
+}
+
+bool FileUpdateSink::diverge()
+{
+    m_matching = false;
+    m_temp = std::fopen(m_temp_path.string().c_str(), m_text ? "w" : "wb");
+
+    if (!m_temp)
+    {
+        m_failed = true;
+        return false;
+    }
+
+    m_temp_sink = std::make_unique<XmlFileSink>(m_temp, &m_buffers.output);
+
+    // Carry over the prefix that matched before we knew the file would change.
+    if (m_matched)
+    {
+        // The comparison block is free again by now.
+        std::rewind(m_existing);
+        std::vector<char>& block = m_buffers.compare;
+        block.resize(block_size);
+        std::size_t remaining = m_matched;
+
+        while (remaining)
+        {
+            std::size_t chunk = std::min(remaining, block.size());
+
+            if (std::fread(block.data(), 1, chunk, m_existing) != chunk)
+            {
+                m_failed = true;
+                return false;
+            }
+
+            m_temp_sink->write(block.data(), chunk);
+            remaining -= chunk;
+        }
+    }
+
+    return true;
+}
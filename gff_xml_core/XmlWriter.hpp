@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+// Destination for XmlWriter output, and for the other text writers in this library.
+class XmlSink
+{
+public:
+    virtual ~XmlSink() = default;
+    virtual void write(const char* data, std::size_t len) = 0;
+};
+
+// Collects output in memory, appending to the given vector.
+class MemorySink : public XmlSink
+{
+public:
+    MemorySink(std::vector<std::byte>* out)
+        : m_out(out)
+    { }
+
+    void write(const char* data, std::size_t len) override
+    {
+        const std::byte* bytes = reinterpret_cast<const std::byte*>(data);
+        m_out->insert(std::end(*m_out), bytes, bytes + len);
+    }
+
+private:
+    std::vector<std::byte>* m_out;
+};
+
+// Collects output in a fixed block and hands it to the FILE* in large writes. buffer, if given, is used for the block
+// instead of a fresh allocation.
+class XmlFileSink : public XmlSink
+{
+public:
+    XmlFileSink(std::FILE* file, std::vector<char>* buffer = nullptr);
+    ~XmlFileSink();
+
+    void write(const char* data, std::size_t len) override;
+
+    // Writes out anything still buffered. Returns false if any write to the file failed.
+    bool flush();
+
+private:
+    std::FILE* m_file;
+    std::vector<char> m_own_buffer;
+    std::vector<char>& m_buffer;
+    std::size_t m_used;
+    bool m_failed;
+};
+
+// Working memory for FileUpdateSink. Handing the same one to each sink in turn (never two at once) saves every file
+// from allocating and freeing its own blocks.
+struct SinkBuffers
+{
+    std::vector<char> pending;
+    std::vector<char> compare;
+    std::vector<char> output;
+};
+
+// Replaces a file only if the new content differs from what is already there, so untouched outputs keep their
+// mtime. Output is compared against the existing file as it streams in; nothing is written until the first
+// difference, at which point the matching prefix is copied into a temporary file next to the target and the rest
+// follows. finish() then renames the temporary over the target. Memory use is a pair of fixed blocks either way.
+class FileUpdateSink : public XmlSink
+{
+public:
+    enum class Result
+    {
+        Unchanged,
+        Written,
+        Failed
+    };
+
+    // text selects text mode for both the comparison and the write, matching how the file would normally be opened.
+    FileUpdateSink(std::filesystem::path path, bool text, SinkBuffers* buffers = nullptr);
+    ~FileUpdateSink();
+
+    void write(const char* data, std::size_t len) override;
+
+    Result finish();
+
+private:
+    static constexpr std::size_t block_size = 64 * 1024;
+
+    void process(const char* data, std::size_t len);
+    bool diverge();
+
+    std::filesystem::path m_path;
+    std::filesystem::path m_temp_path;
+    bool m_text;
+    std::FILE* m_existing;
+    std::FILE* m_temp;
+    std::size_t m_matched;
+    bool m_matching;
+    bool m_failed;
+    SinkBuffers m_own_buffers;
+    SinkBuffers& m_buffers;
+    std::unique_ptr<XmlFileSink> m_temp_sink;
+};
+
+// Streaming XML emitter. Formats exactly as tinyxml2's XMLPrinter does in its default (non-compact) mode - the same
+// four space indentation, entity escaping and number formatting - so output is byte-identical to building an
+// XMLDocument and calling SaveFile, without ever holding more than the current element stack in memory.
+// Element names must stay alive until the matching close_element.
+class XmlWriter
+{
+public:
+    XmlWriter(XmlSink* sink);
+
+    // Writes a piece of a larger document as it would appear inside depth elements that are already open, so that
+    // parts of one document can be formatted separately - on different threads, say - and then spliced together in
+    // order with write_fragment.
+    XmlWriter(XmlSink* sink, int depth);
+
+    // Seals the open element and appends the output of a writer constructed with a depth one more than this one's.
+    void write_fragment(const char* data, std::size_t len);
+
+    void open_element(const char* name);
+
+    void push_attribute(const char* name, const char* value);
+    void push_attribute(const char* name, int value);
+    void push_attribute(const char* name, unsigned value);
+
+    void push_text(const char* text);
+    void push_text(int value);
+    void push_text(unsigned value);
+    void push_text(std::int64_t value);
+    void push_text(std::uint64_t value);
+    void push_text(float value);
+    void push_text(double value);
+
+    void close_element();
+
+private:
+    void seal_element_if_just_opened();
+    void print_space(int depth);
+    void print_string(const char* str, bool restricted);
+    void write(const char* str);
+    void write(const char* data, std::size_t len) { m_sink->write(data, len); }
+    void put_char(char ch) { m_sink->write(&ch, 1); }
+
+    XmlSink* m_sink;
+    std::vector<const char*> m_stack;
+    int m_depth;
+    int m_text_depth;
+    bool m_element_just_opened;
+    bool m_first_element;
+};
@@ -1,26 +1,277 @@
 #include "FileFormats/Gff.hpp"
+#include "gff_xml_core/ContentHash.hpp"
 #include "gff_xml_core/GffXml.hpp"
+#include "gff_xml_core/WorkPool.hpp"
+#include "Metrics.hpp"
 
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 using namespace FileFormats::Gff;
 
+struct CacheEntry
+{
+    std::string path_out; // Relative to the output directory.
+    std::uint64_t hash;
+    std::uintmax_t size;
+    std::int64_t mtime;
+    std::uint32_t version;
+};
+
+// Outputs named by the cache are removed when stale, so only plain relative paths are taken from it - never one that
+// could reach outside the output directory.
+bool is_safe_output_path(const std::filesystem::path& path)
+{
+    if (path.empty() || path.has_root_name() || path.has_root_directory() || !path.has_filename()) return false;
+
+    for (const std::filesystem::path& part : path)
+    {
+        if (part == "..") return false;
+    }
+
+    return true;
+}
+
+// Remembers what every input looked like the last time it was converted successfully, so that unchanged inputs can
+// be skipped. Stored in the output directory as PACKER_CACHE, one tab-separated line per input, keyed by the input's
+// path relative to the input directory. An input whose size and mtime both match is taken as unchanged without being
+// read, so an edit that keeps the size within the same mtime tick goes unnoticed; --no-cache forces a full pass. Only
+// when the stamp differs is the content hashed, so a touched but otherwise identical file is still skipped.
+class ConversionCache
+{
+public:
+    explicit ConversionCache(std::filesystem::path root)
+        : m_root(std::move(root)),
+          m_cache_file(m_root / "PACKER_CACHE")
+    {
+        if (std::ifstream cached(m_cache_file); cached)
+        {
+            std::string line;
+
+            // Whole lines however long, so a long path can't split an entry into fragments.
+            while (std::getline(cached, line))
+            {
+                char* fields[6];
+                std::size_t count = 0;
+
+                for (char* tok = std::strtok(line.data(), "\t"); tok && count < 6; tok = std::strtok(nullptr, "\t"))
+                {
+                    fields[count++] = tok;
+                }
+
+                if (count != 6 || !is_safe_output_path(fields[1])) continue;
+
+                CacheEntry entry;
+                entry.path_out = fields[1];
+                entry.hash = std::strtoull(fields[2], nullptr, 16);
+                entry.size = std::strtoull(fields[3], nullptr, 10);
+                entry.mtime = std::strtoll(fields[4], nullptr, 10);
+                entry.version = (std::uint32_t)std::strtoul(fields[5], nullptr, 10);
+                m_entries[fields[0]] = std::move(entry);
+            }
+
+            std::printf("Read %zu entries from %s.\n", m_entries.size(), m_cache_file.string().c_str());
+        }
+    }
+
+    const CacheEntry* find(const std::string& key) const
+    {
+        auto iter = m_entries.find(key);
+        return iter == std::end(m_entries) ? nullptr : &iter->second;
+    }
+
+    const std::unordered_map<std::string, CacheEntry>& entries() const
+    {
+        return m_entries;
+    }
+
+    bool save(const std::vector<std::pair<std::string, CacheEntry>>& entries)
+    {
+        FILE* cached = std::fopen(m_cache_file.string().c_str(), "w");
+        if (!cached) return false;
+
+        for (const auto& [key, entry] : entries)
+        {
+            std::fprintf(cached, "%s\t%s\t%016" PRIx64 "\t%ju\t%" PRId64 "\t%u\n",
+                key.c_str(), entry.path_out.c_str(), entry.hash, entry.size, entry.mtime, entry.version);
+        }
+
+        return std::fclose(cached) == 0;
+    }
+
+private:
+    std::filesystem::path m_root;
+    std::filesystem::path m_cache_file;
+    std::unordered_map<std::string, CacheEntry> m_entries;
+};
+
+struct PackJob
+{
+    std::filesystem::path path_in;
+    std::filesystem::path path_out;
+    std::string key;
+    ConvertReport report;
+    bool success = false;
+    bool skipped = false;
+    CacheEntry entry;
+};
+
+// Fills in job.entry with the input's current stamp and hash, and reports whether the cached conversion still holds.
+bool is_up_to_date(PackJob& job, const ConversionCache& cache, const std::filesystem::path& root_out)
+{
+    std::error_code ec;
+    job.entry.size = std::filesystem::file_size(job.path_in, ec);
+    bool stamped = !ec;
+    job.entry.mtime = (std::int64_t)std::filesystem::last_write_time(job.path_in, ec).time_since_epoch().count();
+    stamped = stamped && !ec;
+    job.entry.version = gff_xml_output_version;
+
+    if (!stamped)
+    {
+        // Zeroed rather than left as whatever the failed call returned, so the cache never records a bogus stamp.
+        job.entry.size = 0;
+        job.entry.mtime = 0;
+    }
+
+    const CacheEntry* cached = cache.find(job.key);
+
+    // Switching output format (--gfft) changes the expected output path. A ".?" output only resolves on conversion,
+    // but its extension comes from the content, so the hash check covers it.
+    bool candidate = cached && stamped
+        && cached->version == gff_xml_output_version
+        && (job.path_out.extension() == ".?"
+            || std::filesystem::relative(job.path_out, root_out).generic_string() == cached->path_out)
+        && std::filesystem::exists(root_out / cached->path_out, ec);
+
+    if (candidate && cached->size == job.entry.size && cached->mtime == job.entry.mtime)
+    {
+        job.entry.hash = cached->hash;
+        job.entry.path_out = cached->path_out;
+        return true;
+    }
+
+    if (!hash_file(job.path_in, &job.entry.hash)) return false;
+
+    if (candidate && cached->hash == job.entry.hash)
+    {
+        job.entry.path_out = cached->path_out;
+        return true;
+    }
+
+    return false;
+}
+
+// Prints each job's captured output strictly in work-list order as jobs complete, so the log reads the same
+// regardless of how many threads ran or which of them finished first.
+class OrderedLog
+{
+public:
+    OrderedLog(std::vector<PackJob>& jobs)
+        : m_jobs(jobs), m_done(jobs.size(), false), m_next(0)
+    { }
+
+    void complete(std::size_t index)
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_done[index] = true;
+
+        while (m_next < m_jobs.size() && m_done[m_next])
+        {
+            std::fputs(m_jobs[m_next].report.log.c_str(), stdout);
+            ++m_next;
+        }
+
+        std::fflush(stdout);
+    }
+
+private:
+    std::vector<PackJob>& m_jobs;
+    std::vector<bool> m_done;
+    std::size_t m_next;
+    std::mutex m_lock;
+};
+
 int main(int argc, char** argv)
 {
-    std::filesystem::path path_out = argv[1];
-    std::filesystem::path path_in = argv[2];
+    std::size_t thread_count = 1;
+    bool use_cache = true;
+    const char* text_ext = "xml";
+    const char* report_path = nullptr;
+    ConvertOptions options;
+    std::vector<const char*> args;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            // -j 0 picks one thread per hardware thread.
+            thread_count = std::strtoul(argv[++i], nullptr, 10);
+            thread_count = thread_count ? thread_count : WorkPool::hardware_thread_count();
+        }
+        else if (std::strcmp(argv[i], "--verify-roundtrip") == 0)
+        {
+            options.verify_roundtrip = true;
+        }
+        else if (std::strcmp(argv[i], "--no-cache") == 0)
+        {
+            use_cache = false;
+        }
+        else if (std::strcmp(argv[i], "--gfft") == 0)
+        {
+            // gff -> xml writes the compact line format instead of XML. xml -> gff reads both regardless.
+            text_ext = "gfft";
+        }
+        else if (std::strcmp(argv[i], "--report") == 0 && i + 1 < argc)
+        {
+            // Per-file metrics, as CSV if the path ends in .csv and as JSON otherwise.
+            report_path = argv[++i];
+            options.count_nodes = true;
+        }
+        else
+        {
+            args.push_back(argv[i]);
+        }
+    }
+
+    if (args.size() < 2)
+    {
+        std::printf("Usage: gff_xml_packer [-j threads] [--verify-roundtrip] [--no-cache] [--gfft] [--report file] <path_out> <path_in>\n");
+        return 1;
+    }
+
+    std::filesystem::path path_out = args[0];
+    std::filesystem::path path_in = args[1];
 
     std::filesystem::create_directory(path_out);
 
-    bool any_failure = false;
+    std::vector<PackJob> jobs;
     std::vector<std::string> unprocessed_paths;
 
-    if (std::filesystem::exists(path_in / "REPO_ROOT"))
+    // Build the full work list up front; only the conversions themselves run on the pool.
+
+    bool xml_to_gff = std::filesystem::exists(path_in / "REPO_ROOT");
+
+    if (xml_to_gff)
     {
         std::printf("Batch mode: xml -> gff.\n");
 
+        if (options.verify_roundtrip)
+        {
+            std::printf("--verify-roundtrip only checks gff -> xml; ignoring it.\n");
+            options.verify_roundtrip = false;
+        }
+
         for (const auto& file : std::filesystem::recursive_directory_iterator(path_in))
         {
             if (!file.is_regular_file()) continue;
@@ -28,7 +279,7 @@ int main(int argc, char** argv)
             std::filesystem::path file_path = file.path();
             std::string ext = file_path.has_extension() ? file_path.extension().string().substr(1) : "";
 
-            if (ext != "xml")
+            if (ext != "xml" && ext != "gfft")
             {
                 unprocessed_paths.emplace_back(file_path.string());
                 continue;
@@ -37,12 +288,15 @@ int main(int argc, char** argv)
             std::filesystem::path new_file_path = path_out;
             new_file_path /= file_path.filename();
             new_file_path.replace_extension("?");
-            any_failure |= !convert_file(file_path, new_file_path);
+            PackJob& job = jobs.emplace_back();
+            job.key = std::filesystem::relative(file_path, path_in).generic_string();
+            job.path_in = std::move(file_path);
+            job.path_out = std::move(new_file_path);
         }
     }
     else
     {
-        std::printf("Batch mode: gff -> xml.\n");
+        std::printf("Batch mode: gff -> %s.\n", text_ext);
 
         static std::unordered_set<std::string> permitted_gff_types =
         {
@@ -69,10 +323,194 @@ int main(int argc, char** argv)
             std::filesystem::create_directory(new_file_path);
 
             new_file_path /= file_path.filename();
-            new_file_path.replace_extension("xml");
-            any_failure |= !convert_file(file_path, new_file_path);
+            new_file_path.replace_extension(text_ext);
+            PackJob& job = jobs.emplace_back();
+            job.key = std::filesystem::relative(file_path, path_in).generic_string();
+            job.path_in = std::move(file_path);
+            job.path_out = std::move(new_file_path);
         }
+    }
+
+    // Directory iteration order is up to the filesystem; sort so runs are reproducible across machines.
+    std::sort(std::begin(jobs), std::end(jobs),
+        [](const PackJob& lhs, const PackJob& rhs) { return lhs.path_in < rhs.path_in; });
+    std::sort(std::begin(unprocessed_paths), std::end(unprocessed_paths));
+
+    // Loaded whatever the options, as it's also the record of what to clean up. Verifying round-trips is only
+    // meaningful if every file actually gets converted, so that never skips anything.
+    ConversionCache cache(path_out);
+    bool skip_unchanged = use_cache && !options.verify_roundtrip;
 
+    std::fflush(stdout);
+
+    OrderedLog log(jobs);
+
+    // Inputs that could resolve to the same output - foo.xml beside foo.gfft, or files of the same name in different
+    // folders of the repo - run one after another in work-list order rather than at once, so that no two conversions
+    // ever write one file together. Such clashes are reported as failures below.
+    std::vector<std::vector<std::size_t>> groups;
+    std::unordered_map<std::string, std::size_t> group_of;
+
+    for (std::size_t i = 0; i < jobs.size(); ++i)
+    {
+        auto [iter, added] = group_of.try_emplace(jobs[i].path_out.string(), groups.size());
+        if (added) groups.emplace_back();
+        groups[iter->second].push_back(i);
+    }
+
+    auto run_job = [&](std::size_t index)
+    {
+        PackJob& job = jobs[index];
+
+        try
+        {
+            // Checked either way, as it fills in the entry the cache will record.
+            if (is_up_to_date(job, cache, path_out) && skip_unchanged)
+            {
+                job.skipped = true;
+                job.success = true;
+            }
+            else
+            {
+                // One per worker thread, reused for every file that thread converts.
+                thread_local ConvertScratch scratch;
+                job.success = convert_file(job.path_in, job.path_out, options, &job.report, &scratch);
+                job.entry.path_out = std::filesystem::relative(job.report.path_out, path_out).generic_string();
+            }
+        }
+        catch (const std::exception& ex)
+        {
+            job.report.log += "Failed: ";
+            job.report.log += ex.what();
+            job.report.log += "\n";
+            job.report.failure = ex.what();
+            job.success = false;
+        }
+
+        log.complete(index);
+    };
+
+    WorkPool(thread_count).run(groups.size(), [&](std::size_t group)
+    {
+        for (std::size_t index : groups[group])
+        {
+            run_job(index);
+        }
+    });
+
+    // Whichever of two inputs resolving to one output came last would silently win; fail both instead.
+    std::unordered_map<std::string, std::size_t> claimed_outputs;
+
+    for (std::size_t i = 0; i < jobs.size(); ++i)
+    {
+        if (!jobs[i].success) continue;
+
+        auto [iter, added] = claimed_outputs.try_emplace(jobs[i].entry.path_out, i);
+        if (added) continue;
+
+        PackJob& first = jobs[iter->second];
+        std::string failure = first.key + " and " + jobs[i].key + " both convert to " + jobs[i].entry.path_out + ".";
+        std::printf("Failed: %s\n", failure.c_str());
+
+        for (PackJob* job : { &first, &jobs[i] })
+        {
+            job->success = false;
+            job->skipped = false;
+            job->report.failure = failure;
+        }
+    }
+
+    bool any_failure = false;
+    std::size_t skipped = 0;
+    std::size_t failed = 0;
+    std::size_t written = 0;
+    std::vector<std::pair<std::string, CacheEntry>> new_entries;
+    std::unordered_set<std::string> live_outputs;
+    std::unordered_set<std::string> failed_inputs;
+
+    for (PackJob& job : jobs)
+    {
+        any_failure |= !job.success;
+        skipped += job.skipped;
+
+        if (!job.success)
+        {
+            ++failed;
+            failed_inputs.insert(job.key);
+        }
+        else
+        {
+            written += job.report.written;
+            live_outputs.insert(job.entry.path_out);
+            new_entries.emplace_back(job.key, job.entry);
+        }
+    }
+
+    // Anything we produced last time that no current input produces - because the source is gone, or because it now
+    // converts to a different path - is stale. Failed inputs keep whatever output they had.
+    std::vector<std::string> stale_outputs;
+
+    for (const auto& [key, entry] : cache.entries())
+    {
+        if (live_outputs.count(entry.path_out) || failed_inputs.count(key)) continue;
+        stale_outputs.push_back(entry.path_out);
+    }
+
+    std::sort(std::begin(stale_outputs), std::end(stale_outputs));
+    std::size_t removed = 0;
+
+    for (const std::string& stale : stale_outputs)
+    {
+        std::error_code ec;
+
+        if (std::filesystem::remove(path_out / stale, ec))
+        {
+            std::printf("Removed stale %s.\n", (path_out / stale).string().c_str());
+            ++removed;
+        }
+    }
+
+    if (!cache.save(new_entries))
+    {
+        std::printf("Failed to write the conversion cache.\n");
+    }
+
+    std::size_t converted = jobs.size() - skipped - failed;
+    std::printf("%zu converted (%zu written, %zu identical to existing output), %zu skipped as unchanged, %zu failed, "
+        "%zu stale removed.\n", converted, written, converted - written, skipped, failed, removed);
+
+    if (report_path)
+    {
+        std::vector<FileMetrics> metrics(jobs.size());
+
+        for (std::size_t i = 0; i < jobs.size(); ++i)
+        {
+            const PackJob& job = jobs[i];
+            FileMetrics& entry = metrics[i];
+            entry.path_in = job.key;
+            entry.path_out = job.entry.path_out;
+            entry.status = job.skipped ? FileMetrics::Status::Skipped
+                : job.success ? FileMetrics::Status::Converted
+                : FileMetrics::Status::Failed;
+            entry.failure = job.report.failure;
+            entry.stats = job.report.stats;
+
+            if (job.skipped)
+            {
+                entry.stats.bytes_in = job.entry.size;
+            }
+        }
+
+        print_metrics_summary(metrics);
+
+        if (!write_metrics_report(report_path, metrics))
+        {
+            std::printf("Failed to write the metrics report to %s.\n", report_path);
+        }
+    }
+
+    if (!xml_to_gff)
+    {
         std::filesystem::path repo_root = path_out;
         repo_root /= "REPO_ROOT";
 
@@ -0,0 +1,298 @@
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <iterator>
+
+namespace {
+
+constexpr std::size_t slowest_count = 20;
+
+struct Phase
+{
+    const char* name;
+    double ConvertStats::* time;
+};
+
+constexpr Phase all_phases[] =
+{
+    { "read", &ConvertStats::read },
+    { "parse", &ConvertStats::parse },
+    { "serialize", &ConvertStats::serialize },
+    { "write", &ConvertStats::write },
+};
+
+struct PhaseSummary
+{
+    double total = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double max = 0.0;
+};
+
+struct Summary
+{
+    std::size_t converted = 0;
+    std::size_t skipped = 0;
+    std::size_t failed = 0;
+    std::uint64_t bytes_in = 0;
+    std::uint64_t bytes_out = 0;
+    PhaseSummary phases[std::size(all_phases)];
+    PhaseSummary total;
+    std::vector<const FileMetrics*> slowest;
+};
+
+double total_time(const ConvertStats& stats)
+{
+    return stats.read + stats.parse + stats.serialize + stats.write;
+}
+
+// Nearest-rank percentiles over times, which is sorted in place.
+PhaseSummary summarise(std::vector<double>& times)
+{
+    PhaseSummary summary;
+    if (times.empty()) return summary;
+
+    std::sort(std::begin(times), std::end(times));
+
+    auto rank = [&](double percentile)
+    {
+        std::size_t index = (std::size_t)(percentile * times.size() + 0.999999);
+        return times[std::clamp<std::size_t>(index, 1, times.size()) - 1];
+    };
+
+    for (double time : times)
+    {
+        summary.total += time;
+    }
+
+    summary.p50 = rank(0.50);
+    summary.p95 = rank(0.95);
+    summary.max = times.back();
+    return summary;
+}
+
+Summary summarise(const std::vector<FileMetrics>& files)
+{
+    Summary summary;
+    std::vector<const FileMetrics*> timed;
+
+    for (const FileMetrics& file : files)
+    {
+        summary.bytes_in += file.stats.bytes_in;
+        summary.bytes_out += file.stats.bytes_out;
+
+        switch (file.status)
+        {
+            case FileMetrics::Status::Converted: ++summary.converted; break;
+            case FileMetrics::Status::Skipped: ++summary.skipped; continue;
+            case FileMetrics::Status::Failed: ++summary.failed; continue; // Stopped part way, so not comparable.
+        }
+
+        timed.push_back(&file);
+    }
+
+    std::vector<double> times(timed.size());
+
+    for (std::size_t i = 0; i < std::size(all_phases); ++i)
+    {
+        std::transform(std::begin(timed), std::end(timed), std::begin(times),
+            [&](const FileMetrics* file) { return file->stats.*all_phases[i].time; });
+        summary.phases[i] = summarise(times);
+    }
+
+    std::transform(std::begin(timed), std::end(timed), std::begin(times),
+        [](const FileMetrics* file) { return total_time(file->stats); });
+    summary.total = summarise(times);
+
+    std::size_t slowest = std::min(slowest_count, timed.size());
+    std::partial_sort(std::begin(timed), std::begin(timed) + slowest, std::end(timed),
+        [](const FileMetrics* lhs, const FileMetrics* rhs) { return total_time(lhs->stats) > total_time(rhs->stats); });
+    summary.slowest.assign(std::begin(timed), std::begin(timed) + slowest);
+
+    return summary;
+}
+
+const char* status_name(FileMetrics::Status status)
+{
+    switch (status)
+    {
+        case FileMetrics::Status::Converted: return "converted";
+        case FileMetrics::Status::Skipped: return "skipped";
+        case FileMetrics::Status::Failed: return "failed";
+    }
+
+    return "";
+}
+
+double ms(double seconds)
+{
+    return seconds * 1000.0;
+}
+
+void print_json_string(FILE* file, const std::string& str)
+{
+    std::fputc('"', file);
+
+    for (char ch : str)
+    {
+        switch (ch)
+        {
+            case '"': std::fputs("\\\"", file); break;
+            case '\\': std::fputs("\\\\", file); break;
+            case '\n': std::fputs("\\n", file); break;
+            case '\r': std::fputs("\\r", file); break;
+            case '\t': std::fputs("\\t", file); break;
+
+            default:
+                if ((unsigned char)ch < 0x20)
+                {
+                    std::fprintf(file, "\\u%04x", (unsigned char)ch);
+                }
+                else
+                {
+                    std::fputc(ch, file);
+                }
+        }
+    }
+
+    std::fputc('"', file);
+}
+
+// Quoted, with embedded quotes doubled.
+void print_csv_string(FILE* file, const std::string& str)
+{
+    std::fputc('"', file);
+
+    for (char ch : str)
+    {
+        if (ch == '"') std::fputc('"', file);
+        std::fputc(ch, file);
+    }
+
+    std::fputc('"', file);
+}
+
+void write_csv(FILE* file, const std::vector<FileMetrics>& files)
+{
+    std::fprintf(file, "path_in,path_out,status,failure,bytes_in,bytes_out,structs,fields,lists,"
+        "read_ms,parse_ms,serialize_ms,write_ms,total_ms\n");
+
+    for (const FileMetrics& entry : files)
+    {
+        const ConvertStats& stats = entry.stats;
+        print_csv_string(file, entry.path_in);
+        std::fputc(',', file);
+        print_csv_string(file, entry.path_out);
+        std::fprintf(file, ",%s,", status_name(entry.status));
+        print_csv_string(file, entry.failure);
+        std::fprintf(file, ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.3f,%.3f,%.3f,%.3f,%.3f\n",
+            stats.bytes_in, stats.bytes_out, stats.structs, stats.fields, stats.lists,
+            ms(stats.read), ms(stats.parse), ms(stats.serialize), ms(stats.write), ms(total_time(stats)));
+    }
+}
+
+void print_json_phase(FILE* file, const char* name, const PhaseSummary& phase, bool last)
+{
+    std::fprintf(file, "      \"%s\": { \"total_ms\": %.3f, \"p50_ms\": %.3f, \"p95_ms\": %.3f, \"max_ms\": %.3f }%s\n",
+        name, ms(phase.total), ms(phase.p50), ms(phase.p95), ms(phase.max), last ? "" : ",");
+}
+
+void write_json(FILE* file, const std::vector<FileMetrics>& files)
+{
+    std::fprintf(file, "{\n  \"files\": [");
+
+    for (std::size_t i = 0; i < files.size(); ++i)
+    {
+        const FileMetrics& entry = files[i];
+        const ConvertStats& stats = entry.stats;
+
+        std::fprintf(file, "%s\n    { \"path_in\": ", i ? "," : "");
+        print_json_string(file, entry.path_in);
+        std::fprintf(file, ", \"path_out\": ");
+        print_json_string(file, entry.path_out);
+        std::fprintf(file, ", \"status\": \"%s\", \"failure\": ", status_name(entry.status));
+        print_json_string(file, entry.failure);
+        std::fprintf(file, ", \"bytes_in\": %" PRIu64 ", \"bytes_out\": %" PRIu64
+            ", \"structs\": %" PRIu64 ", \"fields\": %" PRIu64 ", \"lists\": %" PRIu64
+            ", \"read_ms\": %.3f, \"parse_ms\": %.3f, \"serialize_ms\": %.3f, \"write_ms\": %.3f, \"total_ms\": %.3f }",
+            stats.bytes_in, stats.bytes_out, stats.structs, stats.fields, stats.lists,
+            ms(stats.read), ms(stats.parse), ms(stats.serialize), ms(stats.write), ms(total_time(stats)));
+    }
+
+    Summary summary = summarise(files);
+
+    std::fprintf(file, "\n  ],\n  \"summary\": {\n");
+    std::fprintf(file, "    \"files\": %zu, \"converted\": %zu, \"skipped\": %zu, \"failed\": %zu,\n",
+        files.size(), summary.converted, summary.skipped, summary.failed);
+    std::fprintf(file, "    \"bytes_in\": %" PRIu64 ", \"bytes_out\": %" PRIu64 ",\n", summary.bytes_in, summary.bytes_out);
+    std::fprintf(file, "    \"phases\": {\n");
+
+    for (std::size_t i = 0; i < std::size(all_phases); ++i)
+    {
+        print_json_phase(file, all_phases[i].name, summary.phases[i], false);
+    }
+
+    print_json_phase(file, "total", summary.total, true);
+    std::fprintf(file, "    },\n    \"slowest\": [");
+
+    for (std::size_t i = 0; i < summary.slowest.size(); ++i)
+    {
+        std::fprintf(file, "%s\n      { \"path_in\": ", i ? "," : "");
+        print_json_string(file, summary.slowest[i]->path_in);
+        std::fprintf(file, ", \"total_ms\": %.3f }", ms(total_time(summary.slowest[i]->stats)));
+    }
+
+    std::fprintf(file, "\n    ]\n  }\n}\n");
+}
+
+}
+
+bool write_metrics_report(const std::filesystem::path& path, const std::vector<FileMetrics>& files)
+{
+    FILE* file = std::fopen(path.string().c_str(), "w");
+    if (!file) return false;
+
+    if (path.extension() == ".csv")
+    {
+        write_csv(file, files);
+    }
+    else
+    {
+        write_json(file, files);
+    }
+
+    return std::fclose(file) == 0;
+}
+
+void print_metrics_summary(const std::vector<FileMetrics>& files)
+{
+    Summary summary = summarise(files);
+
+    std::printf("Metrics: %zu converted, %zu skipped, %zu failed; %" PRIu64 " bytes in, %" PRIu64 " bytes out.\n",
+        summary.converted, summary.skipped, summary.failed, summary.bytes_in, summary.bytes_out);
+    std::printf("  %-10s %12s %10s %10s %10s\n", "phase", "total ms", "p50 ms", "p95 ms", "max ms");
+
+    auto print_phase = [](const char* name, const PhaseSummary& phase)
+    {
+        std::printf("  %-10s %12.3f %10.3f %10.3f %10.3f\n", name, ms(phase.total), ms(phase.p50), ms(phase.p95), ms(phase.max));
+    };
+
+    for (std::size_t i = 0; i < std::size(all_phases); ++i)
+    {
+        print_phase(all_phases[i].name, summary.phases[i]);
+    }
+
+    print_phase("total", summary.total);
+
+    if (!summary.slowest.empty())
+    {
+        std::printf("  Slowest %zu:\n", summary.slowest.size());
+
+        for (const FileMetrics* file : summary.slowest)
+        {
+            std::printf("  %10.3f ms  %s\n", ms(total_time(file->stats)), file->path_in.c_str());
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "gff_xml_core/GffXml.hpp"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Per-file record of a packer run, for tracking conversion throughput over time and finding pathological files.
+struct FileMetrics
+{
+    enum class Status
+    {
+        Converted,
+        Skipped, // Up to date according to the cache; nothing but bytes_in is filled in.
+        Failed
+    };
+
+    std::string path_in;
+    std::string path_out;
+    Status status = Status::Converted;
+    std::string failure;
+    ConvertStats stats;
+};
+
+// One row per file, as CSV if path ends in .csv and as JSON otherwise. The JSON also carries the summary below.
+bool write_metrics_report(const std::filesystem::path& path, const std::vector<FileMetrics>& files);
+
+// Totals, p50/p95/max per phase over the files that were actually converted, and the slowest 20 of them. Skipped
+// and failed files are counted but not timed.
+void print_metrics_summary(const std::vector<FileMetrics>& files);
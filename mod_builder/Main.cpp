@@ -1,28 +1,283 @@
-#include "FileFormats/Erf.hpp"
 #include "FileFormats/Gff.hpp"
-
+#include "gff_xml_core/ErfView.hpp"
+#include "gff_xml_core/ErfWriter.hpp"
+#include "gff_xml_core/GffView.hpp"
+#include "gff_xml_core/GffXml.hpp"
+#include "gff_xml_core/MappedFile.hpp"
+#include "gff_xml_core/WorkPool.hpp"
+#include "ModCache.hpp"
+
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
 #include <filesystem>
+#include <memory>
 #include <string>
+#include <system_error>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 using namespace FileFormats;
-using namespace FileFormats::Erf;
+
+namespace {
+
+constexpr std::size_t io_workers_per_core = 4;
+constexpr std::size_t min_io_workers = 16;
+
+// Past this share of dead space, an incremental build writes the .mod afresh rather than updating it again.
+constexpr std::uint64_t compact_dead_percent = 25;
+
+std::string resource_key(std::string_view resref, Resource::ResourceType type)
+{
+    return std::string(resref) + ":" + std::to_string((unsigned)type);
+}
+
+// The .mod an incremental build updates, as it was before the build.
+struct ExistingMod
+{
+    MappedFile data;
+    ErfView view;
+    std::unordered_map<std::string, const ErfResourceView*> resources; // By resource_key.
+    bool cache_usable = false;
+
+    const ErfResourceView* find(const std::string& resref, const std::string& ext) const
+    {
+        auto iter = resources.find(resource_key(resref, Resource::ResourceTypeFromString(ext.c_str())));
+        return iter == std::end(resources) ? nullptr : iter->second;
+    }
+};
+
+// One resource headed for the module. Raw files are only sized up front and streamed into the module as it's
+// written; converted GFFs and module.ifo are held in memory.
+struct ContentFile
+{
+    std::filesystem::path path;
+    std::string key; // The path relative to the content directory, for the ModCache.
+    std::string resref;
+    std::string ext; // The resource type, as an extension without the dot.
+    std::uint64_t size = 0;
+    bool in_memory = false;
+    std::vector<std::byte> data;
+    std::string log;
+    bool success = false;
+
+    // For incremental builds: the file's own stamp, and the resource in the existing .mod when that's already the
+    // same as this.
+    std::uintmax_t source_size = 0;
+    std::int64_t mtime = 0;
+    const ErfResourceView* existing = nullptr;
+};
+
+bool is_module_ifo(const ContentFile& file)
+{
+    return file.resref == "module" && file.ext == "ifo";
+}
+
+// Sizes a file that ErfWriter streams into the module later, one file after another. Its reads are started here, on
+// the pool, so that by then the data is in the page cache rather than a round trip away.
+void size_raw_file(ContentFile& file)
+{
+    std::error_code ec;
+    file.size = std::filesystem::file_size(file.path, ec);
+    file.success = !ec;
+
+    if (!file.success)
+    {
+        file.log += "Failed to open " + file.path.string() + ".\n";
+        return;
+    }
+
+    prefetch_file(file.path);
+}
+
+// Reads the whole file in one request. Faulting in a mapping instead can cost a round trip per readahead window on
+// a network volume.
+void read_raw_file(ContentFile& file)
+{
+    std::error_code ec;
+    std::uintmax_t len = std::filesystem::file_size(file.path, ec);
+    FILE* f = ec ? nullptr : std::fopen(file.path.string().c_str(), "rb");
+
+    if (!f)
+    {
+        file.log += "Failed to open " + file.path.string() + ".\n";
+        return;
+    }
+
+    file.in_memory = true;
+    file.size = len;
+    file.data.resize((std::size_t)len);
+    file.success = len == 0 || std::fread(file.data.data(), (std::size_t)len, 1, f) == 1;
+    std::fclose(f);
+
+    if (!file.success)
+    {
+        file.log += "Failed to read " + file.path.string() + ".\n";
+    }
+}
+
+// Converts an .xml or .gfft from the XML repo to binary GFF in memory. As with gff_xml_packer's ".?" outputs, the
+// resource type comes from the GFF's own file type rather than from the path.
+void convert_repo_file(ContentFile& file)
+{
+    // One per worker thread, reused for every file that thread converts.
+    thread_local ConvertScratch scratch;
+
+    MappedFile data;
+    Gff::Friendly::Gff gff;
+
+    if (!data.open(file.path) || !read_gff(data.data(), data.size(), gff_format_for(file.path), &gff, &file.log, &scratch))
+    {
+        file.log += "Failed to read " + file.path.string() + ".\n";
+        return;
+    }
+
+    file.ext = std::string(gff.GetFileType(), 3);
+    std::transform(std::begin(file.ext), std::end(file.ext), std::begin(file.ext), ::tolower);
+
+    file.in_memory = true;
+    file.success = write_gff(gff, GffFormat::Binary, &file.data, {}, &file.log);
+    file.size = file.data.size();
+
+    if (!file.success)
+    {
+        file.log += "Failed to convert " + file.path.string() + ".\n";
+    }
+}
+
+// Maps the .mod for an incremental build to update in place. Fails, saying why, when it should be written afresh.
+bool open_existing_mod(const std::filesystem::path& path, const ModCache& cache, ExistingMod* mod)
+{
+    if (!std::filesystem::exists(path))
+    {
+        std::printf("Building %s from scratch.\n", path.string().c_str());
+        return false;
+    }
+
+    if (!mod->data.open(path) || !mod->view.open(mod->data.data(), mod->data.size()))
+    {
+        std::printf("Failed to read %s; building it from scratch. %s\n", path.string().c_str(), mod->view.error());
+        return false;
+    }
+
+    if (mod->view.dead_space() * 100 > mod->data.size() * compact_dead_percent)
+    {
+        std::printf("Compacting %s: %ju of its %zu bytes are dead space.\n",
+            path.string().c_str(), (std::uintmax_t)mod->view.dead_space(), mod->data.size());
+        return false;
+    }
+
+    for (const ErfResourceView& res : mod->view.resources())
+    {
+        mod->resources.emplace(resource_key(res.resref, res.type), &res);
+    }
+
+    mod->cache_usable = cache.usable();
+    std::printf("Updating %s.\n", path.string().c_str());
+    return true;
+}
+
+bool stamp_file(ContentFile& file)
+{
+    std::error_code ec;
+    file.source_size = std::filesystem::file_size(file.path, ec);
+    if (ec) return false;
+
+    file.mtime = (std::int64_t)std::filesystem::last_write_time(file.path, ec).time_since_epoch().count();
+    return !ec;
+}
+
+// Whether the cache vouches for the .mod still holding file as it is, going by the file's size and mtime alone. If
+// so, the file needn't be read, let alone converted.
+bool reuse_cached(ContentFile& file, const ExistingMod& mod, const ModCache& cache)
+{
+    const ModCacheEntry* cached = mod.cache_usable ? cache.find(file.key) : nullptr;
+
+    if (!cached || cached->size != file.source_size || cached->mtime != file.mtime) return false;
+    if (file.resref == "module" && cached->ext == "ifo") return false; // Patched every build.
+
+    const ErfResourceView* res = mod.find(file.resref, cached->ext);
+    if (!res) return false;
+
+    file.ext = cached->ext;
+    file.size = res->size;
+    file.existing = res;
+    file.success = true;
+    return true;
+}
+
+bool same_data(const std::byte* data, std::size_t size, const ExistingMod& mod, const ErfResourceView* res)
+{
+    return res && res->size == size && (size == 0 || std::memcmp(data, mod.view.data(*res), size) == 0);
+}
+
+// Whether the .mod already holds file's content, by size and then byte for byte. Both are at hand - the .mod is
+// mapped - so there's nothing a hash would save.
+void match_existing(ContentFile& file, const ExistingMod& mod)
+{
+    const ErfResourceView* res = mod.find(file.resref, file.ext);
+    if (!res || res->size != file.size) return;
+
+    MappedFile source;
+    bool same = file.in_memory
+        ? same_data(file.data.data(), file.data.size(), mod, res)
+        : source.open(file.path) && same_data(source.data(), source.size(), mod, res);
+
+    if (same)
+    {
+        file.existing = res;
+        file.data = {};
+    }
+}
+
+}
 
 int main(int argc, char** argv)
 {
-    std::filesystem::path path_out = argv[1];
-    std::filesystem::path path_in_haks = argv[2];
-    std::filesystem::path path_in_content = argv[3];
+    bool incremental = false;
+    std::vector<const char*> args;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--incremental") == 0)
+        {
+            incremental = true;
+        }
+        else
+        {
+            args.push_back(argv[i]);
+        }
+    }
 
-    using namespace FileFormats::Erf;
+    if (args.size() != 3)
+    {
+        std::printf("Usage: mod_builder [--incremental] <path_out> <path_in_haks> <path_in_content>\n");
+        return 1;
+    }
 
-    Friendly::Erf erf;
+    std::filesystem::path path_out = args[0];
+    std::filesystem::path path_in_haks = args[1];
+    std::filesystem::path path_in_content = args[2];
 
-    Raw::ErfLocalisedString desc;
-    desc.m_LanguageId = 0;
-    desc.m_String = "Anphillia\nhttp://www.anphilliarise.com\nA new epic take on the classic module of Anphillia.";
-    erf.GetDescriptions().emplace_back(std::move(desc));
+    // An incremental build keeps whatever the .mod already holds as it is, and appends the rest - see
+    // ErfWriter::update. Once too much of the .mod is dead space that way, it's written afresh instead.
+    ModCache cache(path_out);
+    std::unique_ptr<ExistingMod> existing;
+
+    if (incremental)
+    {
+        existing = std::make_unique<ExistingMod>();
+
+        if (!open_existing_mod(path_out, cache, existing.get()))
+        {
+            existing.reset();
+        }
+    }
+
+    ErfWriter erf("MOD ");
+    erf.add_description(0,
+        "Anphillia\nhttp://www.anphilliarise.com\nA new epic take on the classic module of Anphillia.");
 
     std::unordered_set<std::string> haks;
     std::unordered_set<std::string> areas;
@@ -43,52 +298,154 @@ int main(int argc, char** argv)
         haks.emplace(std::move(hak));
     }
 
-    Gff::Friendly::Gff module_ifo;
+    // path_in_content is either a directory of resources, packed as they are, or the XML repo that gff_xml_packer
+    // produces. The XML repo is converted in memory on the way in, which saves expanding it to a directory of binary
+    // GFFs first only to read them all back.
+    bool from_repo = std::filesystem::exists(path_in_content / "REPO_ROOT");
+    std::vector<ContentFile> content;
 
     for (const auto& file : std::filesystem::recursive_directory_iterator(path_in_content))
     {
         if (!file.is_regular_file()) continue;
+        if (!file.path().has_extension()) continue; // No resource type - e.g. gff_xml_packer's PACKER_CACHE.
+        if (from_repo && file.path().filename() == "unprocessed.txt") continue; // gff_xml_packer's list of skipped files.
+
+        ContentFile& entry = content.emplace_back();
+        entry.path = file.path();
+        entry.key = file.path().lexically_relative(path_in_content).generic_string();
+        entry.resref = file.path().stem().string();
+        entry.ext = file.path().extension().string().substr(1);
+    }
+
+    // Directory iteration order is up to the filesystem; sort so builds are reproducible across machines.
+    std::sort(std::begin(content), std::end(content),
+        [](const ContentFile& lhs, const ContentFile& rhs) { return lhs.path < rhs.path; });
+
+    if (from_repo)
+    {
+        std::printf("Building from XML repo.\n");
+    }
 
-        if (file.path().filename() == "module.ifo")
+    // Sizing raw content is all waiting on the volume - a round trip or more per file on a network share - so it gets
+    // many more workers than there are cores, to keep plenty of requests in flight at once. Converting the XML repo is
+    // bound by the CPU instead.
+    //
+    // Raw content is only read when ErfWriter streams it into the module, one file at a time. So that this doesn't
+    // pay a round trip per file in turn, the workers ask for every file to be read ahead into the page cache as they
+    // size it (see prefetch_file). The trade-off: where that isn't supported (Windows) the reads stay serial, and a
+    // module larger than the page cache can have its first files evicted again before they're written.
+    std::size_t thread_count = from_repo
+        ? WorkPool::hardware_thread_count()
+        : std::max(WorkPool::hardware_thread_count() * io_workers_per_core, min_io_workers);
+
+    std::printf("Loading %zu files with %zu workers.\n", content.size(), thread_count);
+
+    // Each file's messages are kept with it and printed in order below, so the log reads the same however the loads
+    // interleave.
+    WorkPool(thread_count).run(content.size(), [&](std::size_t index)
+    {
+        ContentFile& file = content[index];
+
+        if (incremental && !stamp_file(file))
+        {
+            file.log += "Failed to open " + file.path.string() + ".\n";
+            return;
+        }
+
+        if (existing && reuse_cached(file, *existing, cache)) return;
+
+        if (from_repo && (file.ext == "xml" || file.ext == "gfft"))
+        {
+            convert_repo_file(file);
+        }
+        else if (is_module_ifo(file))
+        {
+            read_raw_file(file); // Patched below, so needed in memory.
+        }
+        else
         {
-            Gff::Raw::Gff raw_gff;
-            bool loaded = Gff::Raw::Gff::ReadFromFile(file.path().string().c_str(), &raw_gff);
-            ASSERT(loaded);
-            module_ifo = Gff::Friendly::Gff(std::move(raw_gff));
+            size_raw_file(file);
+        }
+
+        if (existing && file.success && !is_module_ifo(file))
+        {
+            match_existing(file, *existing);
+        }
+    });
+
+    // module.ifo is only patched, never decoded - see GffEdit.
+    std::vector<std::byte> module_ifo_data;
+    GffView module_ifo_view;
+    bool have_module_ifo = false;
+    bool any_failure = false;
+    std::size_t kept = 0;
+    std::vector<std::pair<std::string, ModCacheEntry>> cache_entries;
+
+    for (ContentFile& file : content)
+    {
+        std::fputs(file.log.c_str(), stdout);
+
+        if (!file.success)
+        {
+            any_failure = true;
+            continue;
+        }
+
+        if (incremental)
+        {
+            cache_entries.push_back({ std::move(file.key), { file.source_size, file.mtime, file.ext } });
+        }
+
+        if (is_module_ifo(file))
+        {
+            module_ifo_data = std::move(file.data);
+            have_module_ifo = module_ifo_view.open(module_ifo_data.data(), module_ifo_data.size());
+
+            if (!have_module_ifo)
+            {
+                std::printf("Failed to read %s: %s\n", file.path.string().c_str(), module_ifo_view.error());
+                any_failure = true;
+            }
+
             continue; // We'll add it back later.
         }
 
-        if (file.path().extension() == ".are")
+        if (file.ext == "are")
         {
-            areas.emplace(file.path().stem().string());
+            areas.emplace(file.resref);
         }
 
-        std::uintmax_t len = std::filesystem::file_size(file);
-        std::printf("Packing %s [%zu].\n", file.path().string().c_str(), len);
-        std::unique_ptr<OwningDataBlock> db = std::make_unique<OwningDataBlock>();
-        db->m_Data.resize(len);
+        Resource::ResourceType type = Resource::ResourceTypeFromString(file.ext.c_str());
 
-        FILE* f = std::fopen(file.path().string().c_str(), "rb");
-        ASSERT(f);
+        if (file.existing)
+        {
+            erf.add_existing(std::move(file.resref), type, file.existing->offset, file.existing->size);
+            ++kept;
+            continue;
+        }
 
-        if (f)
+        std::printf("Packing %s [%ju].\n", file.path.string().c_str(), (std::uintmax_t)file.size);
+
+        if (file.in_memory)
         {
-            std::fread(db->m_Data.data(), len, 1, f);
-            std::fclose(f);
+            erf.add_data(std::move(file.resref), type, std::move(file.data));
         }
         else
         {
-            continue;
+            erf.add_file(std::move(file.resref), type, std::move(file.path), file.size);
         }
+    }
 
-        Friendly::ErfResource res;
-        res.m_ResRef = file.path().stem().string();
-        res.m_ResType = FileFormats::Resource::ResourceTypeFromString(file.path().extension().string().substr(1).c_str());
-        res.m_DataBlock = std::move(db);
-        erf.GetResources().emplace_back(std::move(res));
+    if (any_failure)
+    {
+        std::printf("Failed to load the module content.\n");
+        return 1;
     }
 
-    // For module.ifo, we strip Mod_Area_list, Mod_HakList, and Mod_CustomTlk, then repopulate it from above.
+    // For module.ifo, we replace Mod_Area_list, Mod_HakList, and Mod_CustomTlk with what we found above.
+
+    GffEdit module_ifo(have_module_ifo ? &module_ifo_view : nullptr);
+    Gff::Friendly::GffStruct& module_ifo_top = module_ifo.edit_struct(0);
 
     Gff::Friendly::Type_List gff_areas, gff_haks;
 
@@ -118,31 +475,74 @@ int main(int argc, char** argv)
         gff_haks.GetStructs().emplace_back(std::move(struc));
     }
 
-    module_ifo.GetTopLevelStruct().WriteField("Mod_Area_list", std::move(gff_areas));
-    module_ifo.GetTopLevelStruct().WriteField("Mod_HakList", std::move(gff_haks));
+    module_ifo_top.WriteField("Mod_Area_list", std::move(gff_areas));
+    module_ifo_top.WriteField("Mod_HakList", std::move(gff_haks));
 
     Gff::Friendly::Type_CExoString gff_customtlk;
     gff_customtlk.m_String = custom_tlk;
-    module_ifo.GetTopLevelStruct().WriteField("Mod_CustomTlk", std::move(gff_customtlk));
+    module_ifo_top.WriteField("Mod_CustomTlk", std::move(gff_customtlk));
+    module_ifo.set_file_type("IFO ");
 
-    const char* ifo_ext = "IFO ";
-    std::memcpy(module_ifo.GetFileType(), ifo_ext, 4);
+    std::vector<std::byte> ifo;
 
-    std::unique_ptr<OwningDataBlock> db = std::make_unique<OwningDataBlock>();
+    if (!module_ifo.write(&ifo))
+    {
+        std::printf("Failed to write module.ifo: %s\n", module_ifo.error());
+        return 1;
+    }
 
-    size_t len_required = module_ifo.WriteToBytes(nullptr, 0);
-    db->m_Data.resize(len_required);
-    size_t len_written = module_ifo.WriteToBytes(db->m_Data.data(), len_required);
-    ASSERT(len_required == len_written);
+    // Regenerated every build, but usually just as it was.
+    const ErfResourceView* existing_ifo = existing ? existing->find("module", "ifo") : nullptr;
 
-    Friendly::ErfResource res;
-    res.m_ResRef = "module";
-    res.m_ResType = FileFormats::Resource::ResourceType::IFO;
-    res.m_DataBlock = std::move(db);
-    erf.GetResources().emplace_back(std::move(res));
+    if (existing && same_data(ifo.data(), ifo.size(), *existing, existing_ifo))
+    {
+        erf.add_existing("module", Resource::ResourceType::IFO, existing_ifo->offset, existing_ifo->size);
+        ++kept;
+    }
+    else
+    {
+        erf.add_data("module", Resource::ResourceType::IFO, std::move(ifo));
+    }
+
+    std::string error;
+    bool success;
+
+    if (existing)
+    {
+        std::size_t total = existing->view.resources().size();
+        std::printf("Kept %zu resources in place.\n", kept);
+
+        // Nothing was added, changed or taken away, so the .mod is left alone.
+        bool up_to_date = kept == total && kept == content.size() + !have_module_ifo;
+
+        // The mapping has to go before the .mod can be written to on some platforms.
+        existing.reset();
+
+        if (up_to_date)
+        {
+            std::printf("Up to date.\n");
+            success = true;
+        }
+        else
+        {
+            success = erf.update(path_out, &error);
+        }
+    }
+    else
+    {
+        success = erf.write(path_out, &error);
+    }
 
-    const char* mod_ext = "MOD ";
-    std::memcpy(erf.GetFileType(), mod_ext, 4);
+    if (!success)
+    {
+        std::printf("%s\n", error.c_str());
+        return 1;
+    }
+
+    if (incremental && !cache.save(cache_entries))
+    {
+        std::printf("Failed to save the build cache for %s.\n", path_out.string().c_str());
+    }
 
-    return !erf.WriteToFile(path_out.string().c_str());
+    return 0;
 }
@@ -0,0 +1,102 @@
+#include "ModCache.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Bump whenever the same content would be packed differently, so that older caches are ignored.
+constexpr std::uint32_t mod_cache_version = 1;
+
+}
+
+ModCache::ModCache(std::filesystem::path path_out)
+    : m_path_out(std::move(path_out)),
+      m_cache_file(m_path_out.string() + ".cache"),
+      m_loaded(false),
+      m_size(0),
+      m_mtime(0)
+{
+    FILE* cached = std::fopen(m_cache_file.string().c_str(), "r");
+    if (!cached) return;
+
+    // First the build, then one tab-separated line per content file: its key, size, mtime and type.
+    unsigned version = 0;
+
+    if (std::fscanf(cached, "%u\t%ju\t%" SCNd64 "\n", &version, &m_size, &m_mtime) == 3
+        && version == mod_cache_version)
+    {
+        char buf[2048];
+        m_loaded = true;
+
+        while (std::fgets(buf, sizeof(buf), cached))
+        {
+            char* fields[4];
+            std::size_t count = 0;
+
+            for (char* tok = std::strtok(buf, "\t\n"); tok && count < 4; tok = std::strtok(nullptr, "\t\n"))
+            {
+                fields[count++] = tok;
+            }
+
+            if (count != 4)
+            {
+                m_loaded = false;
+                break;
+            }
+
+            ModCacheEntry entry;
+            entry.size = std::strtoull(fields[1], nullptr, 10);
+            entry.mtime = std::strtoll(fields[2], nullptr, 10);
+            entry.ext = fields[3];
+            m_entries[fields[0]] = std::move(entry);
+        }
+    }
+
+    std::fclose(cached);
+}
+
+bool ModCache::usable() const
+{
+    std::uintmax_t size;
+    std::int64_t mtime;
+
+    return m_loaded && read_stamp(&size, &mtime) && size == m_size && mtime == m_mtime;
+}
+
+const ModCacheEntry* ModCache::find(const std::string& key) const
+{
+    auto iter = m_entries.find(key);
+    return iter == std::end(m_entries) ? nullptr : &iter->second;
+}
+
+bool ModCache::save(const std::vector<std::pair<std::string, ModCacheEntry>>& entries)
+{
+    std::uintmax_t size;
+    std::int64_t mtime;
+    if (!read_stamp(&size, &mtime)) return false;
+
+    FILE* cached = std::fopen(m_cache_file.string().c_str(), "w");
+    if (!cached) return false;
+
+    std::fprintf(cached, "%u\t%ju\t%" PRId64 "\n", mod_cache_version, size, mtime);
+
+    for (const auto& [key, entry] : entries)
+    {
+        std::fprintf(cached, "%s\t%ju\t%" PRId64 "\t%s\n", key.c_str(), entry.size, entry.mtime, entry.ext.c_str());
+    }
+
+    return std::fclose(cached) == 0;
+}
+
+bool ModCache::read_stamp(std::uintmax_t* size, std::int64_t* mtime) const
+{
+    std::error_code ec;
+    *size = std::filesystem::file_size(m_path_out, ec);
+    if (ec) return false;
+
+    *mtime = (std::int64_t)std::filesystem::last_write_time(m_path_out, ec).time_since_epoch().count();
+    return !ec;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct ModCacheEntry
+{
+    std::uintmax_t size;
+    std::int64_t mtime;
+    std::string ext; // The type it was packed as, which for a file from the XML repo comes from its content.
+};
+
+// Remembers the size and mtime of each content file a .mod was last built from, and the size and mtime the .mod had
+// once written. While the .mod is untouched since, a content file whose size and mtime still match is known to be in
+// it as it is, so an incremental build can keep it without reading or converting it. Keyed by the file's path relative
+// to the content directory, and stored next to the .mod with ".cache" appended to its name.
+class ModCache
+{
+public:
+    ModCache(std::filesystem::path path_out);
+
+    // Whether the .mod is still exactly as the cached build left it.
+    bool usable() const;
+
+    const ModCacheEntry* find(const std::string& key) const;
+
+    // Records a build of the .mod from these files, stamped with the .mod as it is now.
+    bool save(const std::vector<std::pair<std::string, ModCacheEntry>>& entries);
+
+private:
+    bool read_stamp(std::uintmax_t* size, std::int64_t* mtime) const;
+
+    std::filesystem::path m_path_out;
+    std::filesystem::path m_cache_file;
+    bool m_loaded;
+    std::uintmax_t m_size;
+    std::int64_t m_mtime;
+    std::unordered_map<std::string, ModCacheEntry> m_entries;
+};
@@ -1,54 +1,70 @@
 #include "FileFormats/Tlk.hpp"
-#include "tinyxml2.h"
+#include "ShardCache.hpp"
+#include "gff_xml_core/FieldCodec.hpp"
+#include "gff_xml_core/MappedFile.hpp"
+#include "gff_xml_core/Profile.hpp"
+#include "gff_xml_core/TlkBinary.hpp"
+#include "gff_xml_core/TlkPatch.hpp"
+#include "gff_xml_core/TlkShards.hpp"
+#include "gff_xml_core/TlkView.hpp"
+#include "gff_xml_core/TlkXml.hpp"
+#include "gff_xml_core/WorkPool.hpp"
+#include "gff_xml_core/XmlWriter.hpp"
 
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <filesystem>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
 
 using namespace FileFormats::Tlk;
-using namespace tinyxml2;
 
 namespace {
 
-bool read_from_xml(std::filesystem::path file, Friendly::Tlk* out)
+[[maybe_unused]] std::uintmax_t file_size_or_zero(const std::filesystem::path& file)
 {
-    XMLDocument doc;
-    if (doc.LoadFile(file.string().c_str()) != XML_SUCCESS) return false;
-    XMLElement* tlk = doc.FirstChildElement("Tlk");
-    out->SetLanguageId(tlk->UnsignedAttribute("LanguageId"));
+    std::error_code ec;
+    std::uintmax_t size = std::filesystem::file_size(file, ec);
+    return ec ? 0 : size;
+}
 
-    XMLElement* entry = tlk->FirstChildElement("Entry");
+bool read_from_xml(std::filesystem::path file, Friendly::Tlk* out, WorkPool& pool)
+{
+    MappedFile data;
 
-    while (entry)
     {
-        Friendly::StrRef strref = entry->UnsignedAttribute("StrRef");
-
-        Friendly::TlkEntry tlk_entry;
+        PROFILE_SCOPE(ProfilePhase::Load);
+        if (!data.open(file)) return false;
+        PROFILE_COUNT(ProfileCounter::BytesIn, data.size());
+    }
 
-        if (XMLElement* inner_child = entry->FirstChildElement("String"))
-        {
-            if (const char* text = inner_child->GetText())
-            {
-                tlk_entry.m_String = text;
-            }
-        }
+    PROFILE_SCOPE(ProfilePhase::Parse);
+    std::string error;
 
-        if (XMLElement* inner_child = entry->FirstChildElement("SoundResRef"))
-        {
-            if (const char* text = inner_child->GetText())
-            {
-                tlk_entry.m_SoundResRef = text;
-            }
-        }
+    if (!read_tlk_xml(data.chars(), data.size(), out, &error, &pool))
+    {
+        std::printf("%s: %s\n", file.string().c_str(), error.c_str());
+        return false;
+    }
 
-        if (XMLElement* inner_child = entry->FirstChildElement("SoundLength"))
-        {
-            tlk_entry.m_SoundLength = inner_child->FloatText();
-        }
+    return true;
+}
 
-        out->Set(strref, std::move(tlk_entry));
+bool read_from_shards(std::filesystem::path dir, Friendly::Tlk* out, WorkPool& pool)
+{
+    // Shards are loaded as they are parsed.
+    PROFILE_SCOPE(ProfilePhase::Parse);
+    TlkShardIndex index;
+    std::string error;
 
-        entry = entry->NextSiblingElement("Entry");
+    if (!read_tlk_shard_index(dir, &index, &error) || !read_tlk_shards(dir, index, out, &pool, &error))
+    {
+        std::printf("%s: %s\n", dir.string().c_str(), error.c_str());
+        return false;
     }
 
     return true;
@@ -57,71 +73,242 @@ bool read_from_xml(std::filesystem::path file, Friendly::Tlk* out)
 bool read_from_tlk(std::filesystem::path file, Friendly::Tlk* out)
 {
     Raw::Tlk tlk_raw;
-    if (!Raw::Tlk::ReadFromFile(file.string().c_str(), &tlk_raw)) return false;
+
+    {
+        // Reading and parsing are one call here.
+        PROFILE_SCOPE(ProfilePhase::Load);
+        if (!Raw::Tlk::ReadFromFile(file.string().c_str(), &tlk_raw)) return false;
+        PROFILE_COUNT(ProfileCounter::BytesIn, file_size_or_zero(file));
+    }
+
+    PROFILE_SCOPE(ProfilePhase::Build);
     *out = Friendly::Tlk(std::move(tlk_raw));
     return true;
 }
 
-bool write_to_xml(std::filesystem::path file, const Friendly::Tlk* in)
+bool write_to_xml(std::filesystem::path file, const Friendly::Tlk* in, WorkPool& pool)
+{
+    PROFILE_SCOPE(ProfilePhase::Write);
+    FileUpdateSink sink(file, true);
+    write_tlk_xml(*in, &sink, &pool);
+    bool success = sink.finish() != FileUpdateSink::Result::Failed;
+    PROFILE_COUNT(ProfileCounter::BytesOut, file_size_or_zero(file));
+    return success;
+}
+
+bool write_to_shards(std::filesystem::path dir, const Friendly::Tlk* in, std::uint32_t entries_per_shard,
+    WorkPool& pool)
+{
+    PROFILE_SCOPE(ProfilePhase::Write);
+    std::string error;
+
+    if (!write_tlk_shards(*in, dir, entries_per_shard, &pool, &error))
+    {
+        std::printf("%s: %s\n", dir.string().c_str(), error.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool write_to_tlk(std::filesystem::path file, const Friendly::Tlk* in)
 {
-    XMLDocument doc;
-    XMLElement* root = doc.NewElement("Tlk");
-    root->SetAttribute("Version", 1);
-    root->SetAttribute("LanguageId", in->GetLanguageId());
+    std::vector<std::byte> data;
+    std::string error;
+    TlkStringStats stats;
 
-    for (const auto& kvp : *in)
     {
-        XMLElement* entry = doc.NewElement("Entry");
-        entry->SetAttribute("StrRef", kvp.first);
+        PROFILE_SCOPE(ProfilePhase::Encode);
 
-        if (kvp.second.m_String)
+        if (!write_tlk_binary(*in, &data, &error, &stats))
         {
-            XMLElement* inner_entry = doc.NewElement("String");
-            inner_entry->SetText(kvp.second.m_String->c_str());
-            entry->InsertEndChild(inner_entry);
+            std::printf("%s: %s\n", file.string().c_str(), error.c_str());
+            return false;
         }
+    }
 
-        if (kvp.second.m_SoundResRef)
-        {
-            XMLElement* inner_entry = doc.NewElement("SoundResRef");
-            inner_entry->SetText(kvp.second.m_SoundResRef->c_str());
-            entry->InsertEndChild(inner_entry);
-        }
+    std::printf("Shared %zu of %zu strings, saving %ju bytes.\n", stats.shared, stats.strings,
+        (std::uintmax_t)stats.bytes_saved);
+
+    PROFILE_SCOPE(ProfilePhase::Write);
+    FileUpdateSink sink(file, false);
+    sink.write(reinterpret_cast<const char*>(data.data()), data.size());
+    PROFILE_COUNT(ProfileCounter::BytesOut, data.size());
+    return sink.finish() != FileUpdateSink::Result::Failed;
+}
+
+// Applies patch to the table mapped in base, read from path_base, and writes the result to path_out - which may be
+// path_base itself.
+bool write_patched(MappedFile& base, const std::filesystem::path& path_base, const TlkPatch& patch,
+    const std::filesystem::path& path_out)
+{
+    std::vector<std::byte> patched;
+    std::string error;
+
+    {
+        PROFILE_SCOPE(ProfilePhase::Encode);
 
-        if (kvp.second.m_SoundLength)
+        if (!apply_tlk_patch(base.data(), base.size(), patch, &patched, &error))
         {
-            XMLElement* inner_entry = doc.NewElement("SoundLength");
-            inner_entry->SetText(*kvp.second.m_SoundLength);
-            entry->InsertEndChild(inner_entry);
+            std::printf("%s: %s\n", path_base.string().c_str(), error.c_str());
+            std::printf("Failed to patch.\n");
+            return false;
         }
+    }
+
+    base.close();
+
+    PROFILE_SCOPE(ProfilePhase::Write);
+    FileUpdateSink sink(path_out, false);
+    sink.write(reinterpret_cast<const char*>(patched.data()), patched.size());
 
-        root->InsertEndChild(entry);
+    if (sink.finish() == FileUpdateSink::Result::Failed)
+    {
+        std::printf("Failed to write.\n");
+        return false;
     }
 
-    doc.InsertFirstChild(root);
-    return doc.SaveFile(file.string().c_str()) == XML_SUCCESS;
+    PROFILE_COUNT(ProfileCounter::BytesOut, patched.size());
+    return true;
 }
 
-bool write_to_tlk(std::filesystem::path file, const Friendly::Tlk* in)
+// Builds a .tlk from a shard directory. Given the cache of an earlier build whose output is still as that build
+// left it, only the shards that changed since are parsed, and the output is patched with them.
+bool build_from_shards(std::filesystem::path dir, std::filesystem::path path_out, WorkPool& pool)
 {
-    return in->WriteToFile(file.string().c_str());
+    TlkShardIndex index;
+    std::vector<std::uint64_t> hashes;
+    std::string error;
+
+    {
+        PROFILE_SCOPE(ProfilePhase::Load);
+
+        if (!read_tlk_shard_index(dir, &index, &error) || !hash_tlk_shards(dir, index, &hashes, &pool, &error))
+        {
+            std::printf("%s: %s\n", dir.string().c_str(), error.c_str());
+            std::printf("Failed to read.\n");
+            return false;
+        }
+    }
+
+    ShardCache cache(path_out);
+    std::vector<Friendly::StrRef> ends;
+
+    if (!cache.usable(index))
+    {
+        Friendly::Tlk tlk;
+
+        if (!read_from_shards(dir, &tlk, pool))
+        {
+            std::printf("Failed to read.\n");
+            return false;
+        }
+
+        ends = ShardCache::shard_ends(index, tlk);
+
+        if (!write_to_tlk(path_out, &tlk))
+        {
+            std::printf("Failed to write.\n");
+            return false;
+        }
+    }
+    else if (cache.up_to_date(index, hashes))
+    {
+        std::printf("Up to date.\n");
+        return true;
+    }
+    else
+    {
+        std::vector<Friendly::StrRef> changed = cache.changed_ranges(index, hashes);
+        std::printf("Patching in %zu changed shards.\n", changed.size());
+
+        MappedFile base;
+        TlkPatch patch;
+
+        {
+            PROFILE_SCOPE(ProfilePhase::Load);
+
+            if (!base.open(path_out))
+            {
+                std::printf("Failed to read.\n");
+                return false;
+            }
+        }
+
+        {
+            PROFILE_SCOPE(ProfilePhase::Parse);
+
+            if (!read_tlk_shard_patch(dir, index, changed, &patch, &pool, &error))
+            {
+                std::printf("%s: %s\n", dir.string().c_str(), error.c_str());
+                std::printf("Failed to read.\n");
+                return false;
+            }
+        }
+
+        // The table ends where its last shard does, as a full build's would - not just below the last entries the
+        // patch deletes, which could leave the empty entries between shards behind when the last shard goes.
+        ends = cache.shard_ends(index, patch);
+        patch.entry_count = ends.empty() ? 0 : *std::max_element(std::begin(ends), std::end(ends));
+
+        if (!write_patched(base, path_out, patch, path_out)) return false;
+    }
+
+    if (!cache.save(index, hashes, ends))
+    {
+        std::printf("Failed to write the shard cache.\n");
+    }
+
+    return true;
 }
-bool convert_file(std::filesystem::path path_in, std::filesystem::path path_out)
+
+// path_in may be a shard directory. With entries_per_shard set, path_out is written as one.
+bool convert_file(std::filesystem::path path_in, std::filesystem::path path_out, WorkPool& pool,
+    std::uint32_t entries_per_shard)
 {
+    std::error_code ec;
+    bool read_shards = std::filesystem::is_directory(path_in, ec);
     bool read_xml = path_in.extension() == ".xml";
+    bool write_shards = entries_per_shard != 0;
     bool write_xml = path_out.extension() == ".xml";
 
     std::printf("Processing %s -> %s.\n", path_in.string().c_str(), path_out.string().c_str());
 
+    if (read_shards && !write_shards && !write_xml)
+    {
+        return build_from_shards(path_in, path_out, pool);
+    }
+
     Friendly::Tlk tlk;
+    bool read_success;
 
-    if (bool read_success = read_xml ? read_from_xml(path_in, &tlk) : read_from_tlk(path_in, &tlk); !read_success)
+    if (read_shards)
+    {
+        read_success = read_from_shards(path_in, &tlk, pool);
+    }
+    else
+    {
+        read_success = read_xml ? read_from_xml(path_in, &tlk, pool) : read_from_tlk(path_in, &tlk);
+    }
+
+    if (!read_success)
     {
         std::printf("Failed to read.\n");
         return false;
     }
 
-    if (bool write_success = write_xml ? write_to_xml(path_out, &tlk) : write_to_tlk(path_out, &tlk); !write_success)
+    bool write_success;
+
+    if (write_shards)
+    {
+        write_success = write_to_shards(path_out, &tlk, entries_per_shard, pool);
+    }
+    else
+    {
+        write_success = write_xml ? write_to_xml(path_out, &tlk, pool) : write_to_tlk(path_out, &tlk);
+    }
+
+    if (!write_success)
     {
         std::printf("Failed to write.\n");
         return false;
@@ -130,9 +317,224 @@ bool convert_file(std::filesystem::path path_in, std::filesystem::path path_out)
     return true;
 }
 
+// Patches path_base with the delta XML at path_patch into path_out, which may be path_base itself.
+bool patch_file(std::filesystem::path path_base, std::filesystem::path path_patch, std::filesystem::path path_out)
+{
+    std::printf("Patching %s with %s -> %s.\n", path_base.string().c_str(), path_patch.string().c_str(),
+        path_out.string().c_str());
+
+    MappedFile base;
+    MappedFile delta;
+    TlkPatch patch;
+    std::string error;
+
+    {
+        PROFILE_SCOPE(ProfilePhase::Load);
+
+        if (!base.open(path_base) || !delta.open(path_patch))
+        {
+            std::printf("Failed to read.\n");
+            return false;
+        }
+
+        PROFILE_COUNT(ProfileCounter::BytesIn, base.size() + delta.size());
+    }
+
+    {
+        PROFILE_SCOPE(ProfilePhase::Parse);
+
+        if (!read_tlk_patch_xml(delta.chars(), delta.size(), &patch, &error))
+        {
+            std::printf("%s: %s\n", path_patch.string().c_str(), error.c_str());
+            std::printf("Failed to read.\n");
+            return false;
+        }
+    }
+
+    return write_patched(base, path_base, patch, path_out);
+}
+
+// "n" or "first-last", inclusive.
+bool parse_strref_range(std::string_view text, Friendly::StrRef* first, Friendly::StrRef* last)
+{
+    std::size_t dash = text.find('-');
+
+    if (dash == std::string_view::npos)
+    {
+        return FieldCodecs::parse_value(text, first) && FieldCodecs::parse_value(text, last);
+    }
+
+    return FieldCodecs::parse_value(text.substr(0, dash), first)
+        && FieldCodecs::parse_value(text.substr(dash + 1), last) && *first <= *last;
+}
+
+// One line per StrRef: the StrRef, string, sound resref and sound length, separated by tabs, with absent parts left
+// empty. Backslashes, tabs and line breaks in the string are escaped so that every entry keeps to its line.
+void print_entry(Friendly::StrRef strref, const TlkEntryView& entry, std::string* line)
+{
+    FieldCodecs::FormatScratch scratch;
+    line->assign(FieldCodecs::format_value(strref, &scratch));
+    line->push_back('\t');
+
+    for (char ch : entry.string.value_or(std::string_view()))
+    {
+        switch (ch)
+        {
+            case '\\': line->append("\\\\"); break;
+            case '\t': line->append("\\t"); break;
+            case '\n': line->append("\\n"); break;
+            case '\r': line->append("\\r"); break;
+            default: line->push_back(ch); break;
+        }
+    }
+
+    line->push_back('\t');
+    line->append(entry.sound_resref.value_or(std::string_view()));
+    line->push_back('\t');
+
+    if (entry.sound_length)
+    {
+        line->append(FieldCodecs::format_value(*entry.sound_length, &scratch));
+    }
+
+    line->push_back('\n');
+    std::fwrite(line->data(), 1, line->size(), stdout);
+}
+
+// Looks StrRefs up straight from the mapped table, touching only their entries and strings. Each of queries is a
+// StrRef or a range of them; without any, they are read from stdin, separated by whitespace. StrRefs past the end of
+// the table print as empty entries, but ranges stop at its end.
+bool query_file(std::filesystem::path path, const std::vector<const char*>& queries)
+{
+    MappedFile data;
+    TlkView view;
+
+    if (!data.open(path) || !view.open(data.data(), data.size()))
+    {
+        std::fprintf(stderr, "%s: %s\n", path.string().c_str(), data.data() ? view.error() : "Failed to read.");
+        return false;
+    }
+
+    std::string line;
+
+    auto query = [&](std::string_view text)
+    {
+        Friendly::StrRef first;
+        Friendly::StrRef last;
+
+        if (!parse_strref_range(text, &first, &last))
+        {
+            std::fprintf(stderr, "Malformed StrRef: %.*s\n", (int)text.size(), text.data());
+            return false;
+        }
+
+        if (first != last)
+        {
+            if (first >= view.size()) return true;
+            last = std::min(last, view.size() - 1);
+        }
+
+        for (std::uint64_t strref = first; strref <= last; ++strref)
+        {
+            TlkEntryView entry;
+
+            if (strref < view.size() && !view.get((Friendly::StrRef)strref, &entry))
+            {
+                std::fprintf(stderr, "%s: %u: %s\n", path.string().c_str(), (unsigned)strref, view.error());
+                return false;
+            }
+
+            print_entry((Friendly::StrRef)strref, entry, &line);
+        }
+
+        return true;
+    };
+
+    bool success = true;
+
+    for (const char* text : queries)
+    {
+        success = query(text) && success;
+    }
+
+    if (queries.empty())
+    {
+        char text[64];
+
+        while (std::scanf("%63s", text) == 1)
+        {
+            success = query(text) && success;
+        }
+    }
+
+    return success;
+}
+
 }
 
 int main(int argc, char** argv)
 {
-    return !convert_file(argv[2], argv[1]);
+    std::size_t thread_count = 1;
+    std::uint32_t entries_per_shard = 0;
+    const char* path_base = nullptr;
+    std::vector<const char*> args;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            // -j 0 picks one thread per hardware thread. Output is the same whatever the count.
+            thread_count = std::strtoul(argv[++i], nullptr, 10);
+            thread_count = thread_count ? thread_count : WorkPool::hardware_thread_count();
+        }
+        else if (std::strcmp(argv[i], "--shards") == 0 && i + 1 < argc)
+        {
+            // --shards 0 picks the default shard size.
+            entries_per_shard = (std::uint32_t)std::strtoul(argv[++i], nullptr, 10);
+            entries_per_shard = entries_per_shard ? entries_per_shard : default_entries_per_shard;
+        }
+        else if (std::strcmp(argv[i], "--patch") == 0 && i + 1 < argc)
+        {
+            path_base = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--profile") == 0)
+        {
+            if (!profile_enable())
+            {
+                std::printf("Profiling is not compiled in; rebuild with ANPH_PROFILING.\n");
+            }
+        }
+        else
+        {
+            args.push_back(argv[i]);
+        }
+    }
+
+    if (args.size() >= 2 && std::strcmp(args[0], "query") == 0)
+    {
+        return !query_file(args[1], std::vector<const char*>(std::begin(args) + 2, std::end(args)));
+    }
+
+    if (args.size() < 2)
+    {
+        std::printf("Usage: tlk_xml [-j threads] [--profile] [--shards entries] <path_out> <path_in>\n");
+        std::printf("       tlk_xml [--profile] --patch <base.tlk> <path_out> <delta.xml>\n");
+        std::printf("       tlk_xml query <path.tlk> [strref | first-last]...\n");
+        return 1;
+    }
+
+    bool success;
+
+    if (path_base)
+    {
+        success = patch_file(path_base, args[1], args[0]);
+    }
+    else
+    {
+        WorkPool pool(thread_count);
+        success = convert_file(args[1], args[0], pool, entries_per_shard);
+    }
+
+    profile_print();
+    return !success;
 }
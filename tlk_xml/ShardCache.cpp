@@ -0,0 +1,181 @@
+#include "ShardCache.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <unordered_set>
+
+using namespace FileFormats::Tlk;
+
+namespace {
+
+// Bump whenever a build from the same shards would come out differently, so that older caches are ignored.
+constexpr std::uint32_t shard_cache_version = 2;
+
+}
+
+ShardCache::ShardCache(std::filesystem::path path_out)
+    : m_path_out(std::move(path_out)),
+      m_cache_file(m_path_out.string() + ".cache"),
+      m_loaded(false),
+      m_size(0),
+      m_mtime(0),
+      m_entries_per_shard(0),
+      m_language_id(0)
+{
+    FILE* cached = std::fopen(m_cache_file.string().c_str(), "r");
+    if (!cached) return;
+
+    // First the build, then one line per shard: its first StrRef, its hash and its end.
+    unsigned version = 0;
+
+    if (std::fscanf(cached, "%u\t%ju\t%" SCNd64 "\t%" SCNu32 "\t%" SCNu32 "\n",
+        &version, &m_size, &m_mtime, &m_entries_per_shard, &m_language_id) == 5 && version == shard_cache_version)
+    {
+        Friendly::StrRef first;
+        CachedShard shard;
+
+        while (std::fscanf(cached, "%" SCNu32 "\t%" SCNx64 "\t%" SCNu32 "\n", &first, &shard.hash, &shard.end) == 3)
+        {
+            m_shards[first] = shard;
+        }
+
+        m_loaded = std::feof(cached);
+    }
+
+    std::fclose(cached);
+}
+
+bool ShardCache::usable(const TlkShardIndex& index) const
+{
+    std::uintmax_t size;
+    std::int64_t mtime;
+
+    return m_loaded && index.entries_per_shard == m_entries_per_shard
+        && read_stamp(&size, &mtime) && size == m_size && mtime == m_mtime;
+}
+
+bool ShardCache::up_to_date(const TlkShardIndex& index, const std::vector<std::uint64_t>& hashes) const
+{
+    return index.language_id == m_language_id && changed_ranges(index, hashes).empty();
+}
+
+std::vector<Friendly::StrRef> ShardCache::changed_ranges(const TlkShardIndex& index,
+    const std::vector<std::uint64_t>& hashes) const
+{
+    std::vector<Friendly::StrRef> changed;
+    std::unordered_set<Friendly::StrRef> current;
+
+    for (std::size_t i = 0; i < index.shards.size(); ++i)
+    {
+        auto cached = m_shards.find(index.shards[i].first);
+        current.insert(index.shards[i].first);
+
+        if (cached == std::end(m_shards) || cached->second.hash != hashes[i])
+        {
+            changed.push_back(index.shards[i].first);
+        }
+    }
+
+    for (const auto& [first, shard] : m_shards)
+    {
+        if (!current.count(first))
+        {
+            changed.push_back(first);
+        }
+    }
+
+    return changed;
+}
+
+std::vector<Friendly::StrRef> ShardCache::shard_ends(const TlkShardIndex& index, const Friendly::Tlk& tlk)
+{
+    std::vector<Friendly::StrRef> ends(index.shards.size(), 0);
+    std::size_t shard = 0;
+
+    // Both are in StrRef order, so one walk over the entries finds the last in every shard.
+    for (auto iter = std::begin(tlk); iter != std::end(tlk); ++iter)
+    {
+        std::uint64_t strref = iter->first;
+
+        while (shard < ends.size() && index.shards[shard].first + (std::uint64_t)index.entries_per_shard <= strref)
+        {
+            ++shard;
+        }
+
+        if (shard < ends.size() && index.shards[shard].first <= strref)
+        {
+            ends[shard] = (Friendly::StrRef)(strref + 1);
+        }
+    }
+
+    return ends;
+}
+
+std::vector<Friendly::StrRef> ShardCache::shard_ends(const TlkShardIndex& index, const TlkPatch& patch) const
+{
+    std::vector<Friendly::StrRef> ends(index.shards.size(), 0);
+
+    for (std::size_t i = 0; i < index.shards.size(); ++i)
+    {
+        Friendly::StrRef first = index.shards[i].first;
+
+        // The patch holds every StrRef of the ranges it replaces, so holding the first means it holds the range.
+        if (!patch.entries.count(first))
+        {
+            auto cached = m_shards.find(first);
+            if (cached != std::end(m_shards)) ends[i] = cached->second.end;
+            continue;
+        }
+
+        auto last = patch.entries.lower_bound((Friendly::StrRef)std::min<std::uint64_t>(
+            (std::uint64_t)first + index.entries_per_shard, std::numeric_limits<Friendly::StrRef>::max()));
+
+        while (last != patch.entries.begin())
+        {
+            --last;
+            if (last->first < first) break;
+
+            if (last->second)
+            {
+                ends[i] = last->first + 1;
+                break;
+            }
+        }
+    }
+
+    return ends;
+}
+
+bool ShardCache::save(const TlkShardIndex& index, const std::vector<std::uint64_t>& hashes,
+    const std::vector<Friendly::StrRef>& ends)
+{
+    std::uintmax_t size;
+    std::int64_t mtime;
+    if (!read_stamp(&size, &mtime)) return false;
+
+    FILE* cached = std::fopen(m_cache_file.string().c_str(), "w");
+    if (!cached) return false;
+
+    std::fprintf(cached, "%u\t%ju\t%" PRId64 "\t%" PRIu32 "\t%" PRIu32 "\n",
+        shard_cache_version, size, mtime, index.entries_per_shard, index.language_id);
+
+    for (std::size_t i = 0; i < index.shards.size(); ++i)
+    {
+        std::fprintf(cached, "%" PRIu32 "\t%016" PRIx64 "\t%" PRIu32 "\n", index.shards[i].first, hashes[i], ends[i]);
+    }
+
+    return std::fclose(cached) == 0;
+}
+
+bool ShardCache::read_stamp(std::uintmax_t* size, std::int64_t* mtime) const
+{
+    std::error_code ec;
+    *size = std::filesystem::file_size(m_path_out, ec);
+    if (ec) return false;
+
+    *mtime = (std::int64_t)std::filesystem::last_write_time(m_path_out, ec).time_since_epoch().count();
+    return !ec;
+}
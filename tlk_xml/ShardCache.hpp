@@ -0,0 +1,62 @@
+#pragma once
+
+#include "gff_xml_core/TlkPatch.hpp"
+#include "gff_xml_core/TlkShards.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+// Remembers the content hash of each shard a .tlk was last built from, and the size and mtime the .tlk had once
+// written, so that the next build from the shards can patch that .tlk with just the shards that changed rather than
+// parse them all again. Stored next to the .tlk with ".cache" appended to its name.
+//
+// Each shard's end - one past its last StrRef, or 0 if it has none - is kept too. The table ends where the last of
+// them does, which the .tlk itself can't tell apart from empty entries once the shard that ended it is gone.
+class ShardCache
+{
+public:
+    ShardCache(std::filesystem::path path_out);
+
+    // Whether the output is still exactly as the cached build left it, with shards of the same size as index's.
+    bool usable(const TlkShardIndex& index) const;
+
+    // Whether the shards and the language are all the same as for the cached build.
+    bool up_to_date(const TlkShardIndex& index, const std::vector<std::uint64_t>& hashes) const;
+
+    // The first StrRef of each range whose shard was added, changed or removed since the cached build.
+    std::vector<FileFormats::Tlk::Friendly::StrRef> changed_ranges(const TlkShardIndex& index,
+        const std::vector<std::uint64_t>& hashes) const;
+
+    // The end of each shard in index, in index order, for a full build of tlk.
+    static std::vector<FileFormats::Tlk::Friendly::StrRef> shard_ends(const TlkShardIndex& index,
+        const FileFormats::Tlk::Friendly::Tlk& tlk);
+
+    // The end of each shard in index once patch is applied: from the patch for the ranges it replaces, and as cached
+    // for the rest.
+    std::vector<FileFormats::Tlk::Friendly::StrRef> shard_ends(const TlkShardIndex& index,
+        const TlkPatch& patch) const;
+
+    // Records a build of the output from these shards, stamped with the output as it is now.
+    bool save(const TlkShardIndex& index, const std::vector<std::uint64_t>& hashes,
+        const std::vector<FileFormats::Tlk::Friendly::StrRef>& ends);
+
+private:
+    struct CachedShard
+    {
+        std::uint64_t hash;
+        FileFormats::Tlk::Friendly::StrRef end;
+    };
+
+    bool read_stamp(std::uintmax_t* size, std::int64_t* mtime) const;
+
+    std::filesystem::path m_path_out;
+    std::filesystem::path m_cache_file;
+    bool m_loaded;
+    std::uintmax_t m_size;
+    std::int64_t m_mtime;
+    std::uint32_t m_entries_per_shard;
+    std::uint32_t m_language_id;
+    std::unordered_map<FileFormats::Tlk::Friendly::StrRef, CachedShard> m_shards;
+};